@@ -0,0 +1,543 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Scalability benchmark for LSRoutingProtocol.
+ *
+ * Builds a point-to-point topology, lets LS bring the network up, then
+ * fails one link at a time.  For the bring-up and for every failure it
+ * writes one CSV row per node:
+ *
+ *   topology,nodes,links,seed,phase,node,converged,convergence_s,
+ *   control_bytes,lsa_received,spf_runs,spf_cpu_ms
+ *
+ * converged is 1 if, at the end of the phase, the node has a route to every
+ * other node still reachable over the links that are up.  convergence_s is
+ * then the time from the start of the phase to the last change of that
+ * node's installed routes (0 if nothing changed), and "NA" otherwise.  The
+ * counters are the increase over the phase.
+ *
+ * With --restart=warm or --restart=cold a last phase restarts one node:
+ * warm from an LSDB snapshot, cold from nothing.  A node away from it is
+ * cut off after the snapshot is taken, so the restarted node only
+ * converges if its neighbors resync it.  Its counters in that phase start
+ * at the restart.
+ *
+ *   ./waf --run "ls-scalability-benchmark --topology=grid --nodes=100 --failures=5 --csv=grid-100.csv"
+ *
+ * Topologies: grid (square, rounded down), ring, rgg (random geometric
+ * graph in the unit square, components joined), ba (Barabasi-Albert
+ * preferential attachment with --degree links per new node).
+ */
+
+#include "ns3/core-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/ls-routing-helper.h"
+#include "ns3/ls-routing-protocol.h"
+#include "ns3/network-module.h"
+#include "ns3/point-to-point-module.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("LSScalabilityBenchmark");
+
+struct Link
+{
+  uint32_t a;
+  uint32_t b;
+  uint32_t ifA; //!< IPv4 interface index on node a
+  uint32_t ifB; //!< IPv4 interface index on node b
+};
+
+struct Sample
+{
+  uint64_t controlBytes;
+  uint64_t lsaReceived;
+  uint64_t spfRuns;
+  double spfCpuSeconds;
+};
+
+static std::vector<std::pair<uint32_t, uint32_t>>
+GridEdges (uint32_t &nNodes)
+{
+  uint32_t side = std::max<uint32_t> (2, (uint32_t)std::sqrt ((double)nNodes));
+  nNodes = side * side;
+  std::vector<std::pair<uint32_t, uint32_t>> edges;
+  for (uint32_t r = 0; r < side; r++)
+    {
+      for (uint32_t c = 0; c < side; c++)
+        {
+          uint32_t n = r * side + c;
+          if (c + 1 < side)
+            {
+              edges.push_back (std::make_pair (n, n + 1));
+            }
+          if (r + 1 < side)
+            {
+              edges.push_back (std::make_pair (n, n + side));
+            }
+        }
+    }
+  return edges;
+}
+
+static std::vector<std::pair<uint32_t, uint32_t>>
+RingEdges (uint32_t nNodes)
+{
+  std::vector<std::pair<uint32_t, uint32_t>> edges;
+  for (uint32_t n = 0; n < nNodes; n++)
+    {
+      edges.push_back (std::make_pair (n, (n + 1) % nNodes));
+    }
+  return edges;
+}
+
+static uint32_t
+FindRoot (std::vector<uint32_t> &parent, uint32_t n)
+{
+  while (parent[n] != n)
+    {
+      parent[n] = parent[parent[n]];
+      n = parent[n];
+    }
+  return n;
+}
+
+static std::vector<std::pair<uint32_t, uint32_t>>
+RandomGeometricEdges (uint32_t nNodes, double radius, std::mt19937 &rng)
+{
+  std::uniform_real_distribution<double> unit (0.0, 1.0);
+  std::vector<double> x (nNodes), y (nNodes);
+  for (uint32_t n = 0; n < nNodes; n++)
+    {
+      x[n] = unit (rng);
+      y[n] = unit (rng);
+    }
+  if (radius <= 0)
+    {
+      // Around the connectivity threshold, so the graph is sparse but mostly connected
+      radius = 1.5 * std::sqrt (std::log ((double)nNodes) / (M_PI * nNodes));
+    }
+
+  std::vector<std::pair<uint32_t, uint32_t>> edges;
+  std::vector<uint32_t> parent (nNodes);
+  for (uint32_t n = 0; n < nNodes; n++)
+    {
+      parent[n] = n;
+    }
+  for (uint32_t i = 0; i < nNodes; i++)
+    {
+      for (uint32_t j = i + 1; j < nNodes; j++)
+        {
+          double dx = x[i] - x[j], dy = y[i] - y[j];
+          if (dx * dx + dy * dy <= radius * radius)
+            {
+              edges.push_back (std::make_pair (i, j));
+              parent[FindRoot (parent, i)] = FindRoot (parent, j);
+            }
+        }
+    }
+  // Chain the components together so every node is reachable.
+  uint32_t previous = FindRoot (parent, 0);
+  for (uint32_t n = 1; n < nNodes; n++)
+    {
+      uint32_t root = FindRoot (parent, n);
+      if (root != FindRoot (parent, previous))
+        {
+          edges.push_back (std::make_pair (previous, n));
+          parent[root] = FindRoot (parent, previous);
+        }
+      previous = n;
+    }
+  return edges;
+}
+
+static std::vector<std::pair<uint32_t, uint32_t>>
+BarabasiAlbertEdges (uint32_t nNodes, uint32_t degree, std::mt19937 &rng)
+{
+  degree = std::max<uint32_t> (1, std::min (degree, nNodes - 1));
+  std::vector<std::pair<uint32_t, uint32_t>> edges;
+  // Every edge end is listed once, so a uniform pick is degree-proportional.
+  std::vector<uint32_t> ends;
+  for (uint32_t n = 1; n <= degree; n++)
+    {
+      edges.push_back (std::make_pair (0, n));
+      ends.push_back (0);
+      ends.push_back (n);
+    }
+  for (uint32_t n = degree + 1; n < nNodes; n++)
+    {
+      std::vector<uint32_t> targets;
+      while (targets.size () < degree)
+        {
+          uint32_t t = ends[std::uniform_int_distribution<uint32_t> (0, ends.size () - 1) (rng)];
+          if (std::find (targets.begin (), targets.end (), t) == targets.end ())
+            {
+              targets.push_back (t);
+            }
+        }
+      for (uint32_t i = 0; i < targets.size (); i++)
+        {
+          edges.push_back (std::make_pair (targets[i], n));
+          ends.push_back (targets[i]);
+          ends.push_back (n);
+        }
+    }
+  return edges;
+}
+
+/**
+ * \returns Per node, the number of other nodes it reaches over the links that are up.
+ */
+static std::vector<uint32_t>
+ExpectedRoutes (uint32_t nNodes, const std::vector<Link> &links, const std::vector<bool> &linkUp)
+{
+  std::vector<uint32_t> parent (nNodes);
+  for (uint32_t n = 0; n < nNodes; n++)
+    {
+      parent[n] = n;
+    }
+  for (uint32_t i = 0; i < links.size (); i++)
+    {
+      if (linkUp[i])
+        {
+          parent[FindRoot (parent, links[i].a)] = FindRoot (parent, links[i].b);
+        }
+    }
+  std::vector<uint32_t> componentSize (nNodes, 0);
+  for (uint32_t n = 0; n < nNodes; n++)
+    {
+      componentSize[FindRoot (parent, n)]++;
+    }
+  std::vector<uint32_t> expected (nNodes);
+  for (uint32_t n = 0; n < nNodes; n++)
+    {
+      expected[n] = componentSize[FindRoot (parent, n)] - 1;
+    }
+  return expected;
+}
+
+static std::vector<Sample>
+TakeSample (const std::vector<Ptr<LSRoutingProtocol>> &protocols)
+{
+  std::vector<Sample> samples (protocols.size ());
+  for (uint32_t n = 0; n < protocols.size (); n++)
+    {
+      samples[n].controlBytes = protocols[n]->GetControlBytesSent ();
+      samples[n].lsaReceived = protocols[n]->GetLsaReceivedCount ();
+      samples[n].spfRuns = protocols[n]->GetSpfRunCount ();
+      samples[n].spfCpuSeconds = protocols[n]->GetSpfCpuSeconds ();
+    }
+  return samples;
+}
+
+static void
+WritePhase (std::ostream &csv, const std::string &prefix, const std::string &phase, Time phaseStart,
+            const std::vector<Sample> &before, const std::vector<Ptr<LSRoutingProtocol>> &protocols,
+            const std::vector<uint32_t> &expectedRoutes)
+{
+  std::vector<Sample> after = TakeSample (protocols);
+  double slowest = 0;
+  uint32_t notConverged = 0;
+  for (uint32_t n = 0; n < protocols.size (); n++)
+    {
+      // The last route change says nothing if routes are still missing, so
+      // such a node gets no convergence time at all.
+      bool converged = protocols[n]->GetRouteCount () == expectedRoutes[n];
+      csv << prefix << "," << phase << "," << n << "," << (converged ? 1 : 0) << ",";
+      if (converged)
+        {
+          Time changed = protocols[n]->GetLastRouteChangeTime ();
+          double convergence = (changed >= phaseStart) ? (changed - phaseStart).GetSeconds () : 0.0;
+          slowest = std::max (slowest, convergence);
+          csv << convergence;
+        }
+      else
+        {
+          notConverged++;
+          csv << "NA";
+        }
+      csv << "," << after[n].controlBytes - before[n].controlBytes << ","
+          << after[n].lsaReceived - before[n].lsaReceived << ","
+          << after[n].spfRuns - before[n].spfRuns << ","
+          << (after[n].spfCpuSeconds - before[n].spfCpuSeconds) * 1000.0 << "\n";
+    }
+  csv.flush ();
+  if (notConverged > 0)
+    {
+      std::cerr << phase << ": NOT converged, " << notConverged << " of " << protocols.size ()
+                << " nodes are missing routes" << std::endl;
+    }
+  else
+    {
+      std::cerr << phase << ": converged after " << slowest << " s" << std::endl;
+    }
+}
+
+static void
+FailLink (const std::vector<Ptr<Node>> &nodes, const Link &link)
+{
+  std::cerr << "failing link " << link.a << " - " << link.b << " at " << Simulator::Now ().GetSeconds () << " s"
+            << std::endl;
+  nodes[link.a]->GetObject<Ipv4> ()->SetDown (link.ifA);
+  nodes[link.b]->GetObject<Ipv4> ()->SetDown (link.ifB);
+}
+
+/*
+ * Replace the LS instance of node n with a new one, as if the node had
+ * crashed and come back; snapshotFile empty for a cold restart.
+ */
+static Ptr<LSRoutingProtocol>
+RestartNode (Ptr<Node> node, Ptr<LSRoutingProtocol> old, const std::string &snapshotFile,
+             const std::map<uint32_t, Ipv4Address> &nodeAddressMap,
+             const std::map<Ipv4Address, uint32_t> &addressNodeMap)
+{
+  std::cerr << "restarting node " << node->GetId () << (snapshotFile.empty () ? " cold" : " warm") << " at "
+            << Simulator::Now ().GetSeconds () << " s" << std::endl;
+  ObjectFactory factory;
+  factory.SetTypeId ("LSRoutingProtocol");
+  factory.Set ("SnapshotFile", StringValue (snapshotFile));
+  Ptr<LSRoutingProtocol> fresh = factory.Create<LSRoutingProtocol> ();
+  fresh->SetMainInterface (1);
+  fresh->SetNodeAddressMap (nodeAddressMap);
+  fresh->SetAddressNodeMap (addressNodeMap);
+  // The old instance stays aggregated to the node; Dispose() would take the
+  // node down with it.
+  old->DoDispose ();
+  node->GetObject<Ipv4> ()->SetRoutingProtocol (fresh);
+  fresh->Initialize ();
+  return fresh;
+}
+
+int
+main (int argc, char *argv[])
+{
+  std::string topology = "grid";
+  uint32_t nNodes = 16;
+  uint32_t degree = 2;
+  double radius = 0;
+  uint32_t failures = 3;
+  double settle = 30;
+  uint32_t seed = 1;
+  std::string csvFile;
+  std::string restart = "none";
+
+  CommandLine cmd;
+  cmd.AddValue ("topology", "grid, ring, rgg or ba", topology);
+  cmd.AddValue ("nodes", "Number of nodes (grid rounds down to a square)", nNodes);
+  cmd.AddValue ("degree", "Links per new node for ba", degree);
+  cmd.AddValue ("radius", "Connection radius for rgg in the unit square; 0 picks one", radius);
+  cmd.AddValue ("failures", "Number of single-link failures to inject after bring-up", failures);
+  cmd.AddValue ("settle", "Seconds given to each phase to converge", settle);
+  cmd.AddValue ("seed", "Seed for topology generation and failure choice", seed);
+  cmd.AddValue ("csv", "Output file; standard output if empty", csvFile);
+  cmd.AddValue ("restart", "Restart a node after the failures: none, warm or cold", restart);
+  cmd.Parse (argc, argv);
+  if (restart != "none" && restart != "warm" && restart != "cold")
+    {
+      NS_FATAL_ERROR ("Unknown restart " << restart);
+    }
+
+  std::mt19937 rng (seed);
+  std::vector<std::pair<uint32_t, uint32_t>> edges;
+  if (topology == "grid")
+    {
+      edges = GridEdges (nNodes);
+    }
+  else if (topology == "ring")
+    {
+      edges = RingEdges (nNodes);
+    }
+  else if (topology == "rgg")
+    {
+      edges = RandomGeometricEdges (nNodes, radius, rng);
+    }
+  else if (topology == "ba")
+    {
+      edges = BarabasiAlbertEdges (nNodes, degree, rng);
+    }
+  else
+    {
+      NS_FATAL_ERROR ("Unknown topology " << topology);
+    }
+
+  NodeContainer nodeContainer;
+  nodeContainer.Create (nNodes);
+  std::vector<Ptr<Node>> nodes;
+  for (uint32_t n = 0; n < nNodes; n++)
+    {
+      nodes.push_back (nodeContainer.Get (n));
+    }
+
+  LSRoutingHelper lsRouting;
+  InternetStackHelper stack;
+  stack.SetRoutingHelper (lsRouting);
+  stack.Install (nodeContainer);
+
+  PointToPointHelper p2p;
+  p2p.SetDeviceAttribute ("DataRate", StringValue ("100Mbps"));
+  p2p.SetChannelAttribute ("Delay", StringValue ("2ms"));
+  Ipv4AddressHelper addresses;
+  addresses.SetBase ("10.0.0.0", "255.255.255.252");
+
+  std::vector<Link> links;
+  std::map<uint32_t, Ipv4Address> nodeAddressMap;
+  std::map<Ipv4Address, uint32_t> addressNodeMap;
+  for (uint32_t i = 0; i < edges.size (); i++)
+    {
+      NetDeviceContainer devices = p2p.Install (nodes[edges[i].first], nodes[edges[i].second]);
+      Ipv4InterfaceContainer interfaces = addresses.Assign (devices);
+      addresses.NewNetwork ();
+      Link link = {edges[i].first, edges[i].second, interfaces.Get (0).second, interfaces.Get (1).second};
+      links.push_back (link);
+      addressNodeMap[interfaces.GetAddress (0)] = link.a;
+      addressNodeMap[interfaces.GetAddress (1)] = link.b;
+      // The first link of a node carries its main address (interface 1).
+      if (nodeAddressMap.find (link.a) == nodeAddressMap.end ())
+        {
+          nodeAddressMap[link.a] = interfaces.GetAddress (0);
+        }
+      if (nodeAddressMap.find (link.b) == nodeAddressMap.end ())
+        {
+          nodeAddressMap[link.b] = interfaces.GetAddress (1);
+        }
+    }
+
+  std::vector<Ptr<LSRoutingProtocol>> protocols;
+  for (uint32_t n = 0; n < nNodes; n++)
+    {
+      Ptr<LSRoutingProtocol> protocol = nodes[n]->GetObject<LSRoutingProtocol> ();
+      NS_ASSERT (protocol != 0);
+      protocol->SetMainInterface (1);
+      protocol->SetNodeAddressMap (nodeAddressMap);
+      protocol->SetAddressNodeMap (addressNodeMap);
+      protocols.push_back (protocol);
+    }
+
+  std::ofstream csvStream;
+  if (!csvFile.empty ())
+    {
+      csvStream.open (csvFile.c_str ());
+    }
+  std::ostream &csv = csvFile.empty () ? std::cout : csvStream;
+  csv << "topology,nodes,links,seed,phase,node,converged,convergence_s,control_bytes,lsa_received,spf_runs,"
+         "spf_cpu_ms\n";
+  std::ostringstream prefixStream;
+  prefixStream << topology << "," << nNodes << "," << links.size () << "," << seed;
+  std::string prefix = prefixStream.str ();
+
+  // Phase boundaries: bring-up during [0, settle), failure k during
+  // [k * settle, (k + 1) * settle), then the restart.  Each phase is
+  // reported when the next one starts, with the counters sampled at its
+  // own start.
+  static std::vector<Sample> phaseStartSample;
+  phaseStartSample = TakeSample (protocols);
+  std::uniform_int_distribution<uint32_t> pickLink (0, links.size () - 1);
+  // Links still up at the end of each phase, to know which routes to expect
+  std::vector<bool> linkUp (links.size (), true);
+  uint32_t phases = failures + (restart == "none" ? 1 : 2);
+  std::ostringstream snapshotStream;
+  snapshotStream << "ls-scalability-" << seed << ".snapshot";
+  std::string snapshotFile = snapshotStream.str ();
+  for (uint32_t k = 0; k < phases; k++)
+    {
+      Time phaseStart = Seconds (k * settle);
+      Time phaseEnd = Seconds ((k + 1) * settle);
+      std::ostringstream phase;
+      if (k == 0)
+        {
+          phase << "bringup";
+        }
+      else if (k > failures)
+        {
+          phase << "restart-" << restart;
+          std::uniform_int_distribution<uint32_t> pickNode (0, nNodes - 1);
+          uint32_t restarted = pickNode (rng);
+          // Cut off a node that is not a neighbor of the restarted one, so
+          // only LSAs of other nodes change.
+          std::vector<bool> adjacent (nNodes, false);
+          adjacent[restarted] = true;
+          for (uint32_t i = 0; i < links.size (); i++)
+            {
+              if (links[i].a == restarted || links[i].b == restarted)
+                {
+                  adjacent[links[i].a] = adjacent[links[i].b] = true;
+                }
+            }
+          uint32_t isolated = pickNode (rng);
+          for (uint32_t tries = 0; adjacent[isolated] && tries < nNodes; tries++)
+            {
+              isolated = (isolated + 1) % nNodes;
+            }
+          std::string file = (restart == "warm") ? snapshotFile : "";
+          if (!file.empty ())
+            {
+              Simulator::Schedule (phaseStart, [&protocols, restarted, file] () {
+                protocols[restarted]->SetAttribute ("SnapshotFile", StringValue (file));
+                protocols[restarted]->WriteSnapshot ();
+              });
+            }
+          for (uint32_t i = 0; i < links.size (); i++)
+            {
+              if (linkUp[i] && (links[i].a == isolated || links[i].b == isolated))
+                {
+                  linkUp[i] = false;
+                  Simulator::Schedule (phaseStart + MilliSeconds (500), &FailLink, nodes, links[i]);
+                }
+            }
+          Simulator::Schedule (phaseStart + Seconds (2), [&, restarted, file] () {
+            protocols[restarted] = RestartNode (nodes[restarted], protocols[restarted], file,
+                                                nodeAddressMap, addressNodeMap);
+            phaseStartSample[restarted] = Sample ();
+          });
+        }
+      else
+        {
+          phase << "failure-" << k;
+          uint32_t failed = pickLink (rng);
+          linkUp[failed] = false;
+          Simulator::Schedule (phaseStart, &FailLink, nodes, links[failed]);
+        }
+      std::string phaseName = phase.str ();
+      std::vector<uint32_t> expectedRoutes = ExpectedRoutes (nNodes, links, linkUp);
+      Simulator::Schedule (phaseEnd - NanoSeconds (1),
+                           [&csv, &protocols, prefix, phaseName, phaseStart, expectedRoutes] () {
+                             WritePhase (csv, prefix, phaseName, phaseStart, phaseStartSample, protocols,
+                                         expectedRoutes);
+                             phaseStartSample = TakeSample (protocols);
+                           });
+    }
+
+  Simulator::Stop (Seconds (phases * settle));
+  Simulator::Run ();
+  Simulator::Destroy ();
+  if (restart == "warm")
+    {
+      std::remove (snapshotFile.c_str ());
+    }
+  return 0;
+}
@@ -0,0 +1,707 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Micro-benchmark of LSSpfEngine on synthetic graphs, without ns-3.
+ *
+ *   g++ -O2 -std=c++11 -pthread -I<ns-3>/build -o ls-spf-benchmark ls-spf-benchmark.cc ../ls-spf-engine.cc
+ *   ./ls-spf-benchmark [--filter=<substring>] [--min_time=<seconds>] [--max_threads=<n>] [--small]
+ *
+ * <ns-3>/build/ns3 holds the module headers; only the engine's is needed.
+ * Built with -DLS_BENCHMARK_FIB and linked against this module and the
+ * ns-3 core, network and internet modules, it also times the LSFib data
+ * path.
+ *
+ * Every benchmark body is repeated, with the iteration count grown until a
+ * run takes at least --min_time, and reported as time per iteration in
+ * the Google Benchmark layout:
+ *
+ *   LoadLsdb        UpdateAdjacency() for every originator into an empty engine
+ *   FullSpf         ComputeFull() from node 0
+ *   ParallelSpf     the same on 1, 2, 4, ... up to --max_threads threads
+ *                   (default: all cores), with the speedup over FullSpf
+ *   IncrementalSpf  change the cost of one random link, then Compute()
+ *   BatchedSpf      what one SPF hold time may collect: one originator
+ *                   drops a link and brings it back at a new cost, six
+ *                   others change one link cost each, then one Compute()
+ *   Alternates      the same followed by ComputeAlternates() over the
+ *                   neighbors of node 0, one Dijkstra run per neighbor
+ *   AlternatesKept  ComputeAlternates() again with nothing changed, which
+ *                   keeps the last result, with the speedup over Alternates
+ *   LegacySpf       the original list-scanning SPF, on the small graphs only
+ *   FibLegacy       1024 random destinations against a list scanned for
+ *                   the longest match, as Ipv4StaticRouting does; the
+ *                   smaller tables only (ns-3 builds only)
+ *   FibLookup       the same destinations through LSFib::Lookup(), also
+ *                   reported as lookups per second, with the speedup over
+ *                   FibLegacy (ns-3 builds only)
+ *
+ * The default graphs have about four million directed edges each; --small
+ * shrinks them for a quick run.  After the benchmarks of a graph, the tree
+ * left by the incremental runs is checked against a full recomputation
+ * (and against the legacy SPF where it ran), the kept alternates against
+ * freshly computed ones, and every parallel tree against the serial one; a
+ * mismatch fails the program.  The FIB is checked against the list lookup.
+ * Before any of that, verify/batched replays random rounds of several
+ * adjacency updates, some for the same originator, per Compute() on small
+ * graphs and compares every tree and its alternates against a full
+ * recomputation.
+ */
+
+#include "ns3/ls-spf-engine.h"
+
+#ifdef LS_BENCHMARK_FIB
+#include "ns3/ls-fib.h"
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct Graph
+{
+  std::string name;
+  std::vector<LSSpfEngine::Adjacency> adjacency; //!< Indexed by node number
+  uint64_t nEdges;
+};
+
+static double g_minTime = 0.5;
+static std::string g_filter;
+
+static void
+AddLink (Graph &graph, uint32_t a, uint32_t b, uint32_t cost)
+{
+  graph.adjacency[a].push_back (std::make_pair (b, cost));
+  graph.adjacency[b].push_back (std::make_pair (a, cost));
+  graph.nEdges += 2;
+}
+
+static Graph
+MakeGrid (uint32_t rows, uint32_t cols, std::mt19937 &rng)
+{
+  std::uniform_int_distribution<uint32_t> cost (1, 10);
+  Graph graph;
+  graph.name = "grid-" + std::to_string (rows) + "x" + std::to_string (cols);
+  graph.adjacency.resize (rows * cols);
+  graph.nEdges = 0;
+  for (uint32_t r = 0; r < rows; r++)
+    {
+      for (uint32_t c = 0; c < cols; c++)
+        {
+          uint32_t node = r * cols + c;
+          if (c + 1 < cols)
+            {
+              AddLink (graph, node, node + 1, cost (rng));
+            }
+          if (r + 1 < rows)
+            {
+              AddLink (graph, node, node + cols, cost (rng));
+            }
+        }
+    }
+  return graph;
+}
+
+/*
+ * A ring, so that the graph is connected, plus (degree - 2) / 2 random
+ * chords per node.
+ */
+static Graph
+MakeRandom (uint32_t nNodes, uint32_t degree, std::mt19937 &rng)
+{
+  std::uniform_int_distribution<uint32_t> cost (1, 10);
+  std::uniform_int_distribution<uint32_t> pick (0, nNodes - 1);
+  Graph graph;
+  graph.name = "random-" + std::to_string (nNodes) + "-d" + std::to_string (degree);
+  graph.adjacency.resize (nNodes);
+  graph.nEdges = 0;
+  for (uint32_t node = 0; node < nNodes; node++)
+    {
+      AddLink (graph, node, (node + 1) % nNodes, cost (rng));
+      for (uint32_t i = 2; i + 1 < degree; i += 2)
+        {
+          uint32_t other = pick (rng);
+          if (other != node)
+            {
+              AddLink (graph, node, other, cost (rng));
+            }
+        }
+    }
+  return graph;
+}
+
+static void
+Load (const Graph &graph, LSSpfEngine &engine)
+{
+  engine.Clear ();
+  engine.SetMaxPaths (4);
+  for (uint32_t node = 0; node < graph.adjacency.size (); node++)
+    {
+      engine.UpdateAdjacency (node, graph.adjacency[node]);
+    }
+}
+
+/*
+ * The SPF this module started with: a confirmed and a tentative list that
+ * are searched linearly on every relaxation and every pick, O(V * (V + E)).
+ */
+static void
+LegacySpf (const Graph &graph, uint32_t source, std::vector<uint32_t> &cost)
+{
+  std::vector<std::pair<uint32_t, uint32_t>> confirmed; // node, cost
+  std::vector<std::pair<uint32_t, uint32_t>> tentative;
+  confirmed.push_back (std::make_pair (source, 0));
+  uint32_t node = source;
+  uint32_t nodeCost = 0;
+  while (true)
+    {
+      const LSSpfEngine::Adjacency &adjacency = graph.adjacency[node];
+      for (uint32_t i = 0; i < adjacency.size (); i++)
+        {
+          uint32_t neighbor = adjacency[i].first;
+          uint32_t newCost = nodeCost + adjacency[i].second;
+          bool isConfirmed = false;
+          for (uint32_t k = 0; k < confirmed.size (); k++)
+            {
+              if (confirmed[k].first == neighbor)
+                {
+                  isConfirmed = true;
+                }
+            }
+          if (isConfirmed)
+            {
+              continue;
+            }
+          bool isTentative = false;
+          for (uint32_t k = 0; k < tentative.size (); k++)
+            {
+              if (tentative[k].first == neighbor)
+                {
+                  isTentative = true;
+                  if (newCost < tentative[k].second)
+                    {
+                      tentative[k].second = newCost;
+                    }
+                }
+            }
+          if (!isTentative)
+            {
+              tentative.push_back (std::make_pair (neighbor, newCost));
+            }
+        }
+      if (tentative.empty ())
+        {
+          break;
+        }
+      uint32_t best = 0;
+      for (uint32_t k = 1; k < tentative.size (); k++)
+        {
+          if (tentative[k].second < tentative[best].second)
+            {
+              best = k;
+            }
+        }
+      node = tentative[best].first;
+      nodeCost = tentative[best].second;
+      confirmed.push_back (tentative[best]);
+      tentative.erase (tentative.begin () + best);
+    }
+
+  cost.assign (graph.adjacency.size (), LSSpfEngine::INFINITE_COST);
+  for (uint32_t k = 0; k < confirmed.size (); k++)
+    {
+      cost[confirmed[k].first] = confirmed[k].second;
+    }
+}
+
+/*
+ * \returns Wall time per iteration in seconds, or 0 if filtered out.  With
+ * a baseline time, the speedup over it is appended to the report line.
+ */
+static double
+Benchmark (const std::string &name, const std::function<void ()> &body, double baseline = 0)
+{
+  if (!g_filter.empty () && name.find (g_filter) == std::string::npos)
+    {
+      return 0;
+    }
+  uint64_t iterations = 1;
+  double wall;
+  double cpu;
+  while (true)
+    {
+      std::chrono::steady_clock::time_point wallStart = std::chrono::steady_clock::now ();
+      std::clock_t cpuStart = std::clock ();
+      for (uint64_t i = 0; i < iterations; i++)
+        {
+          body ();
+        }
+      cpu = double (std::clock () - cpuStart) / CLOCKS_PER_SEC;
+      wall = std::chrono::duration<double> (std::chrono::steady_clock::now () - wallStart).count ();
+      if (wall >= g_minTime || iterations >= 1000000000)
+        {
+          break;
+        }
+      // Aim a little past the minimum time, growing at most tenfold per step.
+      double target = wall > 0 ? iterations * 1.4 * g_minTime / wall : iterations * 10.0;
+      iterations = std::max<uint64_t> (iterations + 1, std::min<double> (target, iterations * 10.0));
+    }
+  std::printf ("%-44s %14.0f ns %14.0f ns %12llu", name.c_str (), wall * 1e9 / iterations,
+               cpu * 1e9 / iterations, (unsigned long long)iterations);
+  if (baseline > 0)
+    {
+      std::printf (" speedup=%.2fx", baseline * iterations / wall);
+    }
+  std::printf ("\n");
+  std::fflush (stdout);
+  return wall / iterations;
+}
+
+/*
+ * \returns True if engine's alternates match those of a fresh engine
+ * loaded from graph.
+ */
+static bool
+VerifyAlternates (const Graph &graph, const LSSpfEngine &engine, const std::vector<uint32_t> &neighbors)
+{
+  LSSpfEngine fresh;
+  Load (graph, fresh);
+  std::vector<uint32_t> changed;
+  fresh.ComputeFull (0, changed);
+  fresh.ComputeAlternates (neighbors, changed);
+  uint32_t mismatches = 0;
+  for (uint32_t node = 0; node < graph.adjacency.size (); node++)
+    {
+      uint32_t cost = 0;
+      uint32_t freshCost = 0;
+      uint32_t alternate = engine.GetAlternate (node, cost);
+      uint32_t freshAlternate = fresh.GetAlternate (node, freshCost);
+      if (alternate != freshAlternate || (alternate != LSSpfEngine::NO_NODE && cost != freshCost))
+        {
+          if (mismatches++ < 5)
+            {
+              std::printf ("  node %u: alternate %u cost %u, expected %u cost %u\n", node, alternate, cost,
+                           freshAlternate, freshCost);
+            }
+        }
+    }
+  std::printf ("verify/alternates/%s: %s\n", graph.name.c_str (), mismatches ? "MISMATCH" : "ok");
+  return mismatches == 0;
+}
+
+/*
+ * \returns Number of nodes whose cost or first hops differ, printing the
+ * first few.
+ */
+static uint32_t
+CompareTrees (uint32_t nNodes, const LSSpfEngine &engine, const LSSpfEngine &reference)
+{
+  uint32_t mismatches = 0;
+  for (uint32_t node = 0; node < nNodes; node++)
+    {
+      if ((engine.GetCost (node) != reference.GetCost (node) ||
+           engine.GetNextHops (node) != reference.GetNextHops (node)) &&
+          mismatches++ < 5)
+        {
+          std::printf ("  node %u: cost %u, reference %u\n", node, engine.GetCost (node),
+                       reference.GetCost (node));
+        }
+    }
+  return mismatches;
+}
+
+/*
+ * \returns false if the engine's tree differs from a full recomputation,
+ * or its costs from those of the legacy SPF when given.
+ */
+static bool
+Verify (const Graph &graph, LSSpfEngine &engine, const std::vector<uint32_t> *legacyCost)
+{
+  std::vector<uint32_t> changed;
+  engine.Compute (0, changed);
+
+  LSSpfEngine reference;
+  Load (graph, reference);
+  reference.ComputeFull (0, changed);
+
+  uint32_t mismatches = CompareTrees (graph.adjacency.size (), engine, reference);
+  for (uint32_t node = 0; legacyCost && node < graph.adjacency.size (); node++)
+    {
+      if ((*legacyCost)[node] != reference.GetCost (node) && mismatches++ < 5)
+        {
+          std::printf ("  node %u: legacy cost %u, reference %u\n", node, (*legacyCost)[node],
+                       reference.GetCost (node));
+        }
+    }
+  std::printf ("verify/%s: %s\n", graph.name.c_str (), mismatches == 0 ? "ok" : "MISMATCH");
+  return mismatches == 0;
+}
+
+/*
+ * \returns false if the incremental tree or the kept alternates ever differ
+ * from a full recomputation when several updates, possibly of one
+ * originator (as an LSA and a delta within one SPF hold time bring),
+ * precede each Compute().
+ */
+static bool
+VerifyBatched (std::mt19937 &rng)
+{
+  const uint32_t nNodes = 8;
+  uint32_t failed = 0;
+  for (uint32_t round = 0; round < 2000; round++)
+    {
+      std::vector<LSSpfEngine::Adjacency> adjacency (nNodes);
+      LSSpfEngine engine;
+      for (uint32_t node = 0; node < nNodes; node++)
+        {
+          engine.UpdateAdjacency (node, adjacency[node]);
+        }
+      std::vector<uint32_t> changed;
+      for (uint32_t step = 0; step < 20; step++)
+        {
+          for (uint32_t update = rng () % 4; update < 4; update++)
+            {
+              uint32_t node = rng () % nNodes;
+              adjacency[node].clear ();
+              for (uint32_t links = rng () % 3; links > 0; links--)
+                {
+                  adjacency[node].push_back (std::make_pair (rng () % nNodes, 1 + rng () % 5));
+                }
+              engine.UpdateAdjacency (node, adjacency[node]);
+            }
+          engine.Compute (0, changed);
+          // Leave node 1 out even when linked, as the protocol leaves out
+          // links to nodes that are not (or no longer) its neighbors.
+          std::vector<uint32_t> neighbors;
+          for (uint32_t i = 0; i < adjacency[0].size (); i++)
+            {
+              if (adjacency[0][i].first != 1)
+                {
+                  neighbors.push_back (adjacency[0][i].first);
+                }
+            }
+          std::sort (neighbors.begin (), neighbors.end ());
+          neighbors.erase (std::unique (neighbors.begin (), neighbors.end ()), neighbors.end ());
+          engine.ComputeAlternates (neighbors, changed);
+
+          LSSpfEngine reference;
+          for (uint32_t node = 0; node < nNodes; node++)
+            {
+              reference.UpdateAdjacency (node, adjacency[node]);
+            }
+          reference.ComputeFull (0, changed);
+          reference.ComputeAlternates (neighbors, changed);
+          uint32_t mismatches = CompareTrees (nNodes, engine, reference);
+          for (uint32_t node = 0; node < nNodes; node++)
+            {
+              uint32_t cost = 0;
+              uint32_t referenceCost = 0;
+              uint32_t alternate = engine.GetAlternate (node, cost);
+              if (alternate != reference.GetAlternate (node, referenceCost)
+                  || (alternate != LSSpfEngine::NO_NODE && cost != referenceCost))
+                {
+                  mismatches++;
+                }
+            }
+          if (mismatches != 0)
+            {
+              failed++;
+              break;
+            }
+        }
+    }
+  std::printf ("verify/batched: %s\n", failed == 0 ? "ok" : "MISMATCH");
+  return failed == 0;
+}
+
+static bool
+RunGraph (Graph &graph, bool withLegacy, const std::vector<uint32_t> &threadCounts, std::mt19937 &rng)
+{
+  bool ok = true;
+  std::printf ("# %s: %zu nodes, %llu directed edges\n", graph.name.c_str (), graph.adjacency.size (),
+               (unsigned long long)graph.nEdges);
+
+  LSSpfEngine engine;
+  Benchmark ("LoadLsdb/" + graph.name, [&] () { Load (graph, engine); });
+  if (engine.GetNNodes () == 0)
+    {
+      Load (graph, engine);
+    }
+
+  std::vector<uint32_t> changed;
+  double serial = Benchmark ("FullSpf/" + graph.name, [&] () {
+    changed.clear ();
+    engine.ComputeFull (0, changed);
+  });
+  engine.ComputeFull (0, changed);
+
+  // The delta-stepping backend must build exactly the serial tree.
+  for (uint32_t i = 0; i < threadCounts.size (); i++)
+    {
+      std::string name = "ParallelSpf/" + graph.name + "/threads:" + std::to_string (threadCounts[i]);
+      if (!g_filter.empty () && name.find (g_filter) == std::string::npos)
+        {
+          continue;
+        }
+      LSSpfEngine parallel;
+      Load (graph, parallel);
+      parallel.SetThreads (threadCounts[i]);
+      Benchmark (name, [&] () {
+        changed.clear ();
+        parallel.ComputeFull (0, changed);
+      }, serial);
+      if (CompareTrees (graph.adjacency.size (), parallel, engine) != 0)
+        {
+          std::printf ("verify/%s: MISMATCH\n", name.c_str ());
+          ok = false;
+        }
+    }
+
+  // One link cost change per iteration, as a single LSA would bring.  The
+  // graph is updated as well so that Verify() can rebuild from it.
+  std::uniform_int_distribution<uint32_t> pickNode (0, graph.adjacency.size () - 1);
+  std::uniform_int_distribution<uint32_t> pickCost (1, 10);
+  Benchmark ("IncrementalSpf/" + graph.name, [&] () {
+    uint32_t node = pickNode (rng);
+    LSSpfEngine::Adjacency &adjacency = graph.adjacency[node];
+    adjacency[rng () % adjacency.size ()].second = pickCost (rng);
+    engine.UpdateAdjacency (node, adjacency);
+    changed.clear ();
+    engine.Compute (0, changed);
+  });
+
+  // The protocol batches all LSAs that arrive within the SPF hold time into
+  // one run, so the same originator can be updated more than once.
+  Benchmark ("BatchedSpf/" + graph.name, [&] () {
+    uint32_t twice = pickNode (rng);
+    LSSpfEngine::Adjacency &adjacency = graph.adjacency[twice];
+    uint32_t link = rng () % adjacency.size ();
+    LSSpfEngine::Adjacency::value_type dropped = adjacency[link];
+    adjacency.erase (adjacency.begin () + link);
+    engine.UpdateAdjacency (twice, adjacency);
+    for (uint32_t i = 0; i < 6; i++)
+      {
+        uint32_t node = pickNode (rng);
+        LSSpfEngine::Adjacency &other = graph.adjacency[node];
+        if (!other.empty ())
+          {
+            other[rng () % other.size ()].second = pickCost (rng);
+            engine.UpdateAdjacency (node, other);
+          }
+      }
+    dropped.second = pickCost (rng);
+    adjacency.insert (adjacency.begin () + link, dropped);
+    engine.UpdateAdjacency (twice, adjacency);
+    changed.clear ();
+    engine.Compute (0, changed);
+  });
+
+  // Every SPF run is followed by the alternates in the protocol; when the
+  // run moved nothing the engine keeps the previous result instead.
+  std::vector<uint32_t> neighbors;
+  for (uint32_t i = 0; i < graph.adjacency[0].size (); i++)
+    {
+      neighbors.push_back (graph.adjacency[0][i].first);
+    }
+  std::sort (neighbors.begin (), neighbors.end ());
+  neighbors.erase (std::unique (neighbors.begin (), neighbors.end ()), neighbors.end ());
+  double alternates = Benchmark ("Alternates/" + graph.name, [&] () {
+    uint32_t node = pickNode (rng);
+    LSSpfEngine::Adjacency &adjacency = graph.adjacency[node];
+    adjacency[rng () % adjacency.size ()].second = pickCost (rng);
+    engine.UpdateAdjacency (node, adjacency);
+    changed.clear ();
+    engine.Compute (0, changed);
+    engine.ComputeAlternates (neighbors, changed);
+  });
+  changed.clear ();
+  engine.Compute (0, changed);
+  engine.ComputeAlternates (neighbors, changed);
+  Benchmark ("AlternatesKept/" + graph.name, [&] () {
+    changed.clear ();
+    engine.Compute (0, changed);
+    engine.ComputeAlternates (neighbors, changed);
+  }, alternates);
+  ok &= VerifyAlternates (graph, engine, neighbors);
+
+  std::vector<uint32_t> legacyCost;
+  if (withLegacy)
+    {
+      Benchmark ("LegacySpf/" + graph.name, [&] () { LegacySpf (graph, 0, legacyCost); });
+      if (legacyCost.empty ())
+        {
+          LegacySpf (graph, 0, legacyCost);
+        }
+    }
+  return Verify (graph, engine, withLegacy ? &legacyCost : 0) && ok;
+}
+
+#ifdef LS_BENCHMARK_FIB
+/*
+ * nRoutes host routes from 10.0.0.1 upwards under one covering 10.0.0.0/8;
+ * one destination in eight misses the host routes and takes the /8.
+ */
+static bool
+RunFib (uint32_t nRoutes, bool withLegacy, std::mt19937 &rng)
+{
+  struct ListRoute
+  {
+    uint32_t prefix;
+    uint32_t mask;
+    Ptr<Ipv4Route> route;
+  };
+  const uint32_t batch = 1024;
+  std::string name = "routes:" + std::to_string (nRoutes);
+
+  LSFib fib;
+  std::vector<ListRoute> list;
+  for (uint32_t i = 0; i <= nRoutes; i++)
+    {
+      bool network = i == nRoutes;
+      uint32_t prefix = network ? 0x0a000000 : 0x0a000001 + i;
+      Ptr<Ipv4Route> route = Create<Ipv4Route> ();
+      route->SetDestination (Ipv4Address (prefix));
+      route->SetGateway (Ipv4Address (0xc0a80001 + i % 8));
+      Ipv4Mask mask = network ? Ipv4Mask ("255.0.0.0") : Ipv4Mask::GetOnes ();
+      fib.AddRoute (Ipv4Address (prefix), mask, std::vector<Ptr<Ipv4Route>> (1, route));
+      ListRoute entry = {prefix, mask.Get (), route};
+      list.push_back (entry);
+    }
+  fib.Build ();
+
+  std::uniform_int_distribution<uint32_t> pickHost (0, nRoutes - 1);
+  std::vector<Ipv4Address> destinations;
+  for (uint32_t i = 0; i < batch; i++)
+    {
+      uint32_t offset = i % 8 == 7 ? nRoutes + 1 + pickHost (rng) : pickHost (rng);
+      destinations.push_back (Ipv4Address (0x0a000001 + offset));
+    }
+
+  std::function<Ipv4Route *(Ipv4Address)> scan = [&] (Ipv4Address destination) {
+    Ipv4Route *best = 0;
+    uint32_t bestMask = 0;
+    for (uint32_t r = 0; r < list.size (); r++)
+      {
+        if ((destination.Get () & list[r].mask) == list[r].prefix && (best == 0 || list[r].mask > bestMask))
+          {
+            best = PeekPointer (list[r].route);
+            bestMask = list[r].mask;
+          }
+      }
+    return best;
+  };
+  uint32_t found = 0;
+  double legacy = 0;
+  if (withLegacy)
+    {
+      legacy = Benchmark ("FibLegacy/" + name, [&] () {
+        for (uint32_t i = 0; i < batch; i++)
+          {
+            found += scan (destinations[i]) ? 1 : 0;
+          }
+      });
+    }
+  double fast = Benchmark ("FibLookup/" + name, [&] () {
+    for (uint32_t i = 0; i < batch; i++)
+      {
+        found += fib.Lookup (destinations[i], i) ? 1 : 0;
+      }
+  }, legacy);
+  if (fast > 0)
+    {
+      std::printf ("# FibLookup/%s: %.1f M lookups/s\n", name.c_str (), batch / fast / 1e6);
+    }
+
+  uint32_t mismatches = 0;
+  for (uint32_t i = 0; i < batch; i++)
+    {
+      if (PeekPointer (fib.Lookup (destinations[i])) != scan (destinations[i]))
+        {
+          mismatches++;
+        }
+    }
+  std::printf ("verify/fib/%s: %s (%u found)\n", name.c_str (), mismatches ? "MISMATCH" : "ok", found);
+  return mismatches == 0;
+}
+#endif
+
+int
+main (int argc, char *argv[])
+{
+  bool small = false;
+  uint32_t maxThreads = std::max<uint32_t> (2, std::thread::hardware_concurrency ());
+  for (int i = 1; i < argc; i++)
+    {
+      if (std::strncmp (argv[i], "--filter=", 9) == 0)
+        {
+          g_filter = argv[i] + 9;
+        }
+      else if (std::strncmp (argv[i], "--min_time=", 11) == 0)
+        {
+          g_minTime = std::atof (argv[i] + 11);
+        }
+      else if (std::strncmp (argv[i], "--max_threads=", 14) == 0)
+        {
+          maxThreads = std::max (1, std::atoi (argv[i] + 14));
+        }
+      else if (std::strcmp (argv[i], "--small") == 0)
+        {
+          small = true;
+        }
+      else
+        {
+          std::fprintf (stderr, "usage: %s [--filter=<substring>] [--min_time=<seconds>] [--max_threads=<n>] [--small]\n", argv[0]);
+          return 2;
+        }
+    }
+
+  std::printf ("%-44s %17s %17s %12s\n", "Benchmark", "Time", "CPU", "Iterations");
+  std::printf ("%s\n", std::string (93, '-').c_str ());
+
+  std::vector<uint32_t> threadCounts;
+  for (uint32_t threads = 1; threads < maxThreads; threads *= 2)
+    {
+      threadCounts.push_back (threads);
+    }
+  threadCounts.push_back (maxThreads);
+
+  std::mt19937 rng (1);
+  bool ok = VerifyBatched (rng);
+  Graph legacyGrid = MakeGrid (30, 30, rng);
+  ok &= RunGraph (legacyGrid, true, threadCounts, rng);
+  Graph legacyRandom = MakeRandom (2000, 8, rng);
+  ok &= RunGraph (legacyRandom, true, threadCounts, rng);
+
+  Graph grid = small ? MakeGrid (200, 200, rng) : MakeGrid (1000, 1000, rng);
+  ok &= RunGraph (grid, false, threadCounts, rng);
+  grid = Graph ();
+  Graph random = small ? MakeRandom (20000, 16, rng) : MakeRandom (250000, 16, rng);
+  ok &= RunGraph (random, false, threadCounts, rng);
+
+#ifdef LS_BENCHMARK_FIB
+  ok &= RunFib (1000, true, rng);
+  ok &= RunFib (small ? 10000 : 100000, small, rng);
+#endif
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,121 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/ls-fib.h"
+#include "ns3/assert.h"
+
+#include <algorithm>
+
+using namespace ns3;
+
+static inline uint32_t
+PrefixMask (uint8_t length)
+{
+  return (length == 0) ? 0 : (0xffffffffu << (32 - length));
+}
+
+LSFib::LSFib () : m_groupStart (1, 0), m_nRoutes (0) {}
+
+void
+LSFib::Clear ()
+{
+  for (uint32_t i = 0; i <= 32; i++)
+    {
+      m_slots[i].keys.clear ();
+      m_slots[i].groups.clear ();
+    }
+  m_lengths.clear ();
+  m_groupStart.assign (1, 0);
+  m_routes.clear ();
+  m_nRoutes = 0;
+}
+
+void
+LSFib::AddRoute (Ipv4Address prefix, Ipv4Mask mask, const std::vector<Ptr<Ipv4Route>> &routes)
+{
+  NS_ASSERT (!routes.empty ());
+  uint8_t length = mask.GetPrefixLength ();
+  m_slots[length].keys.push_back (prefix.Get () & PrefixMask (length));
+  m_slots[length].groups.push_back (m_groupStart.size () - 1);
+  m_routes.insert (m_routes.end (), routes.begin (), routes.end ());
+  m_groupStart.push_back (m_routes.size ());
+}
+
+void
+LSFib::Build ()
+{
+  m_lengths.clear ();
+  m_nRoutes = 0;
+  for (int length = 32; length >= 0; length--)
+    {
+      Slot &slot = m_slots[length];
+      if (slot.keys.empty ())
+        {
+          continue;
+        }
+
+      // Sort keys and groups together; on duplicate prefixes the group added
+      // first wins.
+      std::vector<std::pair<uint32_t, uint32_t>> order;
+      order.reserve (slot.keys.size ());
+      for (uint32_t i = 0; i < slot.keys.size (); i++)
+        {
+          order.push_back (std::make_pair (slot.keys[i], slot.groups[i]));
+        }
+      std::sort (order.begin (), order.end ());
+
+      slot.keys.clear ();
+      slot.groups.clear ();
+      for (uint32_t i = 0; i < order.size (); i++)
+        {
+          if (!slot.keys.empty () && slot.keys.back () == order[i].first)
+            {
+              continue;
+            }
+          slot.keys.push_back (order[i].first);
+          slot.groups.push_back (order[i].second);
+        }
+      m_lengths.push_back (length);
+      m_nRoutes += slot.keys.size ();
+    }
+}
+
+Ptr<Ipv4Route>
+LSFib::Lookup (Ipv4Address destination, uint32_t flowHash) const
+{
+  uint32_t address = destination.Get ();
+  for (uint32_t i = 0; i < m_lengths.size (); i++)
+    {
+      uint8_t length = m_lengths[i];
+      const Slot &slot = m_slots[length];
+      uint32_t key = address & PrefixMask (length);
+      std::vector<uint32_t>::const_iterator it = std::lower_bound (slot.keys.begin (), slot.keys.end (), key);
+      if (it != slot.keys.end () && *it == key)
+        {
+          uint32_t group = slot.groups[it - slot.keys.begin ()];
+          uint32_t first = m_groupStart[group];
+          uint32_t count = m_groupStart[group + 1] - first;
+          return m_routes[first + (count == 1 ? 0 : flowHash % count)];
+        }
+    }
+  return 0;
+}
+
+uint32_t
+LSFib::GetNRoutes () const
+{
+  return m_nRoutes;
+}
@@ -0,0 +1,87 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef LS_FIB_H
+#define LS_FIB_H
+
+#include "ns3/ipv4-address.h"
+#include "ns3/ipv4-route.h"
+#include "ns3/ptr.h"
+
+#include <vector>
+
+using namespace ns3;
+
+/**
+ * \brief Flat forwarding table used on the data path of LSRoutingProtocol.
+ *
+ * Routes are kept in one sorted key array per prefix length, with the
+ * precomputed Ipv4Route objects in a parallel array.  A lookup tries the
+ * prefix lengths that are actually present, longest first, with a binary
+ * search over contiguous 32-bit keys; it never allocates.
+ *
+ * A prefix may map to a group of equal-cost routes; the caller's flow hash
+ * selects one of them.
+ *
+ * The table is rebuilt from the SPF output: call Clear(), AddRoute() for
+ * every route and then Build() before the next Lookup().
+ */
+class LSFib
+{
+public:
+  LSFib ();
+
+  void Clear ();
+
+  /**
+   * \brief Stage a route for the next Build().
+   *
+   * \param prefix Destination prefix (host bits are ignored).
+   * \param mask Prefix mask; Ipv4Mask::GetOnes() for host routes.
+   * \param routes Equal-cost routes handed out by Lookup() for matching
+   *        destinations; must not be empty.
+   */
+  void AddRoute (Ipv4Address prefix, Ipv4Mask mask, const std::vector<Ptr<Ipv4Route>> &routes);
+
+  /**
+   * \brief Sort the staged routes into lookup order.
+   */
+  void Build ();
+
+  /**
+   * \param destination Destination address.
+   * \param flowHash Hash of the flow; selects among equal-cost routes.
+   * \returns A route of the longest prefix matching destination, or 0.
+   */
+  Ptr<Ipv4Route> Lookup (Ipv4Address destination, uint32_t flowHash = 0) const;
+
+  uint32_t GetNRoutes () const;
+
+private:
+  struct Slot
+  {
+    std::vector<uint32_t> keys;
+    std::vector<uint32_t> groups; //!< Parallel to keys: index into m_groupStart
+  };
+
+  Slot m_slots[33];                    //!< Indexed by prefix length
+  std::vector<uint8_t> m_lengths;       //!< Non-empty prefix lengths, longest first
+  std::vector<uint32_t> m_groupStart;   //!< Route group i is [m_groupStart[i], m_groupStart[i + 1])
+  std::vector<Ptr<Ipv4Route>> m_routes; //!< All routes, grouped
+  uint32_t m_nRoutes;
+};
+
+#endif
@@ -16,12 +16,66 @@
 
 #include "ns3/ls-message.h"
 #include "ns3/log.h"
+#include <utility>
 
 using namespace ns3;
 
 NS_LOG_COMPONENT_DEFINE ("LSMessage");
 NS_OBJECT_ENSURE_REGISTERED (LSMessage);
 
+/* LEB128-style varints for the compact LSA encoding: 7 bits per byte,
+   high bit set on every byte but the last. */
+
+static uint32_t
+VarintSize (uint32_t value)
+{
+  uint32_t size = 1;
+  while (value >= 0x80)
+    {
+      value >>= 7;
+      size++;
+    }
+  return size;
+}
+
+static void
+WriteVarint (Buffer::Iterator &start, uint32_t value)
+{
+  while (value >= 0x80)
+    {
+      start.WriteU8 ((value & 0x7f) | 0x80);
+      value >>= 7;
+    }
+  start.WriteU8 (value);
+}
+
+/* Returns false if the buffer ends before the last byte of the varint, or
+   if the varint is longer than five bytes or does not fit in 32 bits. */
+static bool
+ReadVarint (Buffer::Iterator &start, uint32_t &value)
+{
+  value = 0;
+  for (uint32_t shift = 0; shift < 35; shift += 7)
+    {
+      if (start.GetRemainingSize () == 0)
+        {
+          return false;
+        }
+      uint8_t byte = start.ReadU8 ();
+      if (shift == 28 && (byte & 0xf0))
+        {
+          // The fifth byte has room for bits 28-31 only, and must be the last.
+          return false;
+        }
+      value |= (uint32_t)(byte & 0x7f) << shift;
+      if (!(byte & 0x80))
+        {
+          return true;
+        }
+    }
+  return false;
+}
+
 LSMessage::LSMessage () {}
 
 LSMessage::~LSMessage () {}
@@ -73,6 +127,26 @@ LSMessage::GetSerializedSize (void) const
     case LSA_m:
       size += m_message.lsA.GetSerializedSize ();
       break;
+    case LSA_ACK:
+      size += m_message.lsaAck.GetSerializedSize ();
+      break;
+    case LSA_DELTA:
+      size += m_message.lsaDelta.GetSerializedSize ();
+      break;
+    case BFD_HELLO:
+      break;
+    case DB_DESC:
+      size += m_message.dbDesc.GetSerializedSize ();
+      break;
+    case LSA_REQ:
+      size += m_message.lsaReq.GetSerializedSize ();
+      break;
+    case GRACE:
+      size += m_message.grace.GetSerializedSize ();
+      break;
+    case LS_UPDATE:
+      size += m_message.lsUpdate.GetSerializedSize ();
+      break;
     default:
       NS_ASSERT (false);
     }
@@ -109,6 +183,26 @@ LSMessage::Print (std::ostream &os) const
     case LSA_m:
       m_message.lsA.Print (os);     
       break;
+    case LSA_ACK:
+      m_message.lsaAck.Print (os);
+      break;
+    case LSA_DELTA:
+      m_message.lsaDelta.Print (os);
+      break;
+    case BFD_HELLO:
+      break;
+    case DB_DESC:
+      m_message.dbDesc.Print (os);
+      break;
+    case LSA_REQ:
+      m_message.lsaReq.Print (os);
+      break;
+    case GRACE:
+      m_message.grace.Print (os);
+      break;
+    case LS_UPDATE:
+      m_message.lsUpdate.Print (os);
+      break;
     default:
       break;
     }
@@ -143,6 +237,26 @@ LSMessage::Serialize (Buffer::Iterator start) const
     case LSA_m:
       m_message.lsA.Serialize (i);
       break;
+    case LSA_ACK:
+      m_message.lsaAck.Serialize (i);
+      break;
+    case LSA_DELTA:
+      m_message.lsaDelta.Serialize (i);
+      break;
+    case BFD_HELLO:
+      break;
+    case DB_DESC:
+      m_message.dbDesc.Serialize (i);
+      break;
+    case LSA_REQ:
+      m_message.lsaReq.Serialize (i);
+      break;
+    case GRACE:
+      m_message.grace.Serialize (i);
+      break;
+    case LS_UPDATE:
+      m_message.lsUpdate.Serialize (i);
+      break;
     default:
       NS_ASSERT (false);
     }
@@ -152,38 +266,64 @@ uint32_t
 LSMessage::Deserialize (Buffer::Iterator start)
 {
   uint32_t size;
+  uint32_t body;
   Buffer::Iterator i = start;
+  size = sizeof (uint8_t) + sizeof (uint32_t) + sizeof (uint8_t) + IPV4_ADDRESS_SIZE;
+  // A return of 0 tells the receiver the message could not be framed.
+  if (i.GetRemainingSize () < size)
+    {
+      return 0;
+    }
   m_messageType = (MessageType)i.ReadU8 ();
   m_sequenceNumber = i.ReadNtohU32 ();
   m_ttl = i.ReadU8 ();
   m_originatorAddress = Ipv4Address (i.ReadNtohU32 ());
 
-  size = sizeof (uint8_t) + sizeof (uint32_t) + sizeof (uint8_t) + IPV4_ADDRESS_SIZE;
-
   switch (m_messageType)
     {
     case PING_REQ:
-      size += m_message.pingReq.Deserialize (i);
+      body = m_message.pingReq.Deserialize (i);
       break;
     case PING_RSP:
-      size += m_message.pingRsp.Deserialize (i);
+      body = m_message.pingRsp.Deserialize (i);
       break;
     //*********** new ***********//
     case HELLO_REQ:
-      size += m_message.helloReq.Deserialize (i);
+      body = m_message.helloReq.Deserialize (i);
       break;
     //*********** new ***********//
     case HELLO_RSP:
-      size += m_message.helloRsp.Deserialize (i);
+      body = m_message.helloRsp.Deserialize (i);
       break;
     case LSA_m:
-      m_message.lsA.Deserialize (i);
+      body = m_message.lsA.Deserialize (i);
+      break;
+    case LSA_ACK:
+      body = m_message.lsaAck.Deserialize (i);
+      break;
+    case LSA_DELTA:
+      body = m_message.lsaDelta.Deserialize (i);
+      break;
+    case BFD_HELLO:
+      return size;
+    case DB_DESC:
+      body = m_message.dbDesc.Deserialize (i);
+      break;
+    case LSA_REQ:
+      body = m_message.lsaReq.Deserialize (i);
+      break;
+    case GRACE:
+      body = m_message.grace.Deserialize (i);
+      break;
+    case LS_UPDATE:
+      body = m_message.lsUpdate.Deserialize (i);
       break;
 
     default:
-      NS_ASSERT (false);
+      return 0;
     }
-  return size;
+  // Every body is at least one byte, so 0 means it was cut short.
+  return body == 0 ? 0 : size + body;
 }
 
 /* PING_REQ */
@@ -217,7 +357,16 @@ LSMessage::LsA::GetSerializedSize (void) const
 {
   uint32_t size;
   //size = IPV4_ADDRESS_SIZE + sizeof (uint16_t) + lsaMessage.length ();
-  size =  sizeof (uint16_t) + (sizeof(uint32_t) +sizeof(uint32_t)) * lsaMessage.size();
+  size = sizeof (uint8_t) + VarintSize (lsaMessage.size ());
+  for (unsigned i = 0; i < lsaMessage.size (); i++)
+    {
+      size += VarintSize (lsaMessage[i].first) + VarintSize (lsaMessage[i].second);
+    }
+  size += VarintSize (summaries.size ());
+  for (unsigned i = 0; i < summaries.size (); i++)
+    {
+      size += VarintSize (summaries[i].first) + VarintSize (summaries[i].second);
+    }
   return size;
 }
 
@@ -237,6 +386,10 @@ LSMessage::LsA::Print (std::ostream &os) const
   for (unsigned i = 0; i< lsaMessage.size(); i++){
     os << lsaMessage[i].first <<":" << lsaMessage[i].second<< "\n";
     }
+  for (unsigned i = 0; i < summaries.size (); i++)
+    {
+      os << "summary " << summaries[i].first << ":" << summaries[i].second << "\n";
+    }
 }
 
 void
@@ -261,23 +414,36 @@ void
 LSMessage::LsA::Serialize (Buffer::Iterator &start) const
 {
   //start.WriteHtonU32 (destinationAddress.Get ());
-  start.WriteU16 (lsaMessage.size());
-  //start.WriteHtonU32(lsaMessage.size ());     //check if 16 is needed
+  start.WriteU8 (LS_LSA_ENCODING_VERSION);
+  WriteVarint (start, lsaMessage.size ());
   //start.Write ((uint8_t *)(const_cast<char *> (lsaMessage.c_str ())), lsaMessage.length ());
-  for (unsigned i = 0; i< lsaMessage.size(); i++){
-    start.WriteHtonU32(lsaMessage[i].first);
-    start.WriteHtonU32(lsaMessage[i].second);
-  }
+  for (unsigned i = 0; i < lsaMessage.size (); i++)
+    {
+      WriteVarint (start, lsaMessage[i].first);
+      WriteVarint (start, lsaMessage[i].second);
+    }
+  WriteVarint (start, summaries.size ());
+  for (unsigned i = 0; i < summaries.size (); i++)
+    {
+      WriteVarint (start, summaries[i].first);
+      WriteVarint (start, summaries[i].second);
+    }
 }
 uint32_t
 LSMessage::PingReq::Deserialize (Buffer::Iterator &start)
 {
+  if (start.GetRemainingSize () < IPV4_ADDRESS_SIZE + sizeof (uint16_t))
+    {
+      return 0;
+    }
   destinationAddress = Ipv4Address (start.ReadNtohU32 ());
   uint16_t length = start.ReadU16 ();
-  char *str = (char *)malloc (length);
-  start.Read ((uint8_t *)str, length);
-  pingMessage = std::string (str, length);
-  free (str);
+  if (start.GetRemainingSize () < length)
+    {
+      return 0;
+    }
+  pingMessage.resize (length);
+  start.Read ((uint8_t *)&pingMessage[0], length);
   return PingReq::GetSerializedSize ();
 }
 
@@ -285,12 +451,18 @@ LSMessage::PingReq::Deserialize (Buffer::Iterator &start)
 uint32_t
 LSMessage::HelloReq::Deserialize (Buffer::Iterator &start)
 {
+  if (start.GetRemainingSize () < IPV4_ADDRESS_SIZE + sizeof (uint16_t))
+    {
+      return 0;
+    }
   destinationAddress = Ipv4Address (start.ReadNtohU32 ());
   uint16_t length = start.ReadU16 ();
-  char *str = (char *)malloc (length);
-  start.Read ((uint8_t *)str, length);
-  helloMessage = std::string (str, length);
-  free (str);
+  if (start.GetRemainingSize () < length)
+    {
+      return 0;
+    }
+  helloMessage.resize (length);
+  start.Read ((uint8_t *)&helloMessage[0], length);
   return HelloReq::GetSerializedSize ();
 }
 
@@ -298,19 +470,53 @@ LSMessage::HelloReq::Deserialize (Buffer::Iterator &start)
 uint32_t
 LSMessage::LsA::Deserialize (Buffer::Iterator &start)
 {
-  //destinationAddress = Ipv4Address (start.ReadNtohU32 ());
-  uint16_t length = start.ReadU16 ();
-  //uint32_t length = start.ReadNtohU32 ();  //check if 16 needed
-  //char *str = (char *)malloc (length);
-  //start.Read ((uint8_t *)str, length);
-  //LsaMessage = std::string (str, length);
-  //free (str);
-    for (unsigned i = 0; i < length; i++) {
-      uint32_t neighborNodeNum = start.ReadNtohU32();
-      uint32_t linkwt = start.ReadNtohU32();
-      lsaMessage.push_back(std::make_pair(neighborNodeNum, linkwt));
+  Buffer::Iterator begin = start;
+  if (start.GetRemainingSize () == 0)
+    {
+      return 0;
+    }
+  uint8_t version = start.ReadU8 ();
+  uint32_t length;
+  if (version < 1 || version > LS_LSA_ENCODING_VERSION || !ReadVarint (start, length)
+      || length > start.GetRemainingSize () / 2)
+    {
+      return 0;
+    }
+  // Each entry takes at least two bytes, so length is capped by the buffer
+  // before it sizes anything.
+  lsaMessage.clear ();
+  lsaMessage.reserve (length);
+  for (unsigned i = 0; i < length; i++)
+    {
+      uint32_t neighborNodeNum;
+      uint32_t linkwt;
+      if (!ReadVarint (start, neighborNodeNum) || !ReadVarint (start, linkwt))
+        {
+          return 0;
+        }
+      lsaMessage.push_back (std::make_pair (neighborNodeNum, linkwt));
+    }
+  // Version 1 LSAs end here and carry no summaries
+  summaries.clear ();
+  if (version >= 2)
+    {
+      if (!ReadVarint (start, length) || length > start.GetRemainingSize () / 2)
+        {
+          return 0;
+        }
+      summaries.reserve (length);
+      for (unsigned i = 0; i < length; i++)
+        {
+          uint32_t destNodeNum;
+          uint32_t cost;
+          if (!ReadVarint (start, destNodeNum) || !ReadVarint (start, cost))
+            {
+              return 0;
+            }
+          summaries.push_back (std::make_pair (destNodeNum, cost));
+        }
     }
-  return LsA::GetSerializedSize ();
+  return start.GetDistanceFrom (begin);
 }
 
 void
@@ -325,7 +531,7 @@ LSMessage::SetPingReq (Ipv4Address destinationAddress, std::string pingMessage)
       NS_ASSERT (m_messageType == PING_REQ);
     }
   m_message.pingReq.destinationAddress = destinationAddress;
-  m_message.pingReq.pingMessage = pingMessage;
+  m_message.pingReq.pingMessage = std::move (pingMessage);
 }
 
 //******************* new ****************//
@@ -341,12 +547,12 @@ LSMessage::SetHelloReq (Ipv4Address destinationAddress, std::string helloMessage
       NS_ASSERT (m_messageType == HELLO_REQ);
     }
   m_message.helloReq.destinationAddress = destinationAddress;
-  m_message.helloReq.helloMessage = helloMessage;
+  m_message.helloReq.helloMessage = std::move (helloMessage);
 }
 
 //******************* MS2 ****************//
 void
-LSMessage::SetLsA (neighborInfo lsaMessage)
+LSMessage::SetLsA (neighborInfo lsaMessage, neighborInfo summaries)
 {
   if (m_messageType == 0)
     {
@@ -357,28 +563,471 @@ LSMessage::SetLsA (neighborInfo lsaMessage)
       NS_ASSERT (m_messageType == LSA_m);
     }
   //m_message.lsA.destinationAddress = destinationAddress;
-  m_message.lsA.lsaMessage = lsaMessage;
+  m_message.lsA.lsaMessage = std::move (lsaMessage);
+  m_message.lsA.summaries = std::move (summaries);
 }
 
 
-LSMessage::PingReq
-LSMessage::GetPingReq ()
+const LSMessage::PingReq &
+LSMessage::GetPingReq () const
 {
   return m_message.pingReq;
 }
 // ************************* new *********************** //
-LSMessage::HelloReq
-LSMessage::GetHelloReq ()
+const LSMessage::HelloReq &
+LSMessage::GetHelloReq () const
 {
   return m_message.helloReq;
 }
 
-LSMessage::LsA
-LSMessage::GetLsA()
+const LSMessage::LsA &
+LSMessage::GetLsA () const
 {
   return m_message.lsA;
 }
 
+LSMessage::LsA &
+LSMessage::GetLsA ()
+{
+  return m_message.lsA;
+}
+
+/* LSA_ACK */
+
+uint32_t
+LSMessage::LsaAck::GetSerializedSize (void) const
+{
+  return sizeof (uint16_t) + (IPV4_ADDRESS_SIZE + sizeof (uint32_t)) * acks.size ();
+}
+
+void
+LSMessage::LsaAck::Print (std::ostream &os) const
+{
+  os << "LsaAck:: ";
+  for (unsigned i = 0; i < acks.size (); i++)
+    {
+      os << Ipv4Address (acks[i].first) << ":" << acks[i].second << "\n";
+    }
+}
+
+void
+LSMessage::LsaAck::Serialize (Buffer::Iterator &start) const
+{
+  start.WriteU16 (acks.size ());
+  for (unsigned i = 0; i < acks.size (); i++)
+    {
+      start.WriteHtonU32 (acks[i].first);
+      start.WriteHtonU32 (acks[i].second);
+    }
+}
+
+uint32_t
+LSMessage::LsaAck::Deserialize (Buffer::Iterator &start)
+{
+  if (start.GetRemainingSize () < sizeof (uint16_t))
+    {
+      return 0;
+    }
+  uint16_t length = start.ReadU16 ();
+  if (start.GetRemainingSize () < length * 2 * sizeof (uint32_t))
+    {
+      return 0;
+    }
+  acks.clear ();
+  acks.reserve (length);
+  for (unsigned i = 0; i < length; i++)
+    {
+      uint32_t originator = start.ReadNtohU32 ();
+      uint32_t seq = start.ReadNtohU32 ();
+      acks.push_back (std::make_pair (originator, seq));
+    }
+  return LsaAck::GetSerializedSize ();
+}
+
+void
+LSMessage::SetLsaAck (lsaKeys acks)
+{
+  if (m_messageType == 0)
+    {
+      m_messageType = LSA_ACK;
+    }
+  else
+    {
+      NS_ASSERT (m_messageType == LSA_ACK);
+    }
+  m_message.lsaAck.acks = std::move (acks);
+}
+
+const LSMessage::LsaAck &
+LSMessage::GetLsaAck () const
+{
+  return m_message.lsaAck;
+}
+
+
+
+/* LSA_DELTA */
+
+uint32_t
+LSMessage::LsaDelta::GetSerializedSize (void) const
+{
+  uint32_t size = sizeof (uint8_t) + VarintSize (baseSeq) + VarintSize (changed.size ()) + VarintSize (removed.size ());
+  for (unsigned i = 0; i < changed.size (); i++)
+    {
+      size += VarintSize (changed[i].first) + VarintSize (changed[i].second);
+    }
+  for (unsigned i = 0; i < removed.size (); i++)
+    {
+      size += VarintSize (removed[i]);
+    }
+  return size;
+}
+
+void
+LSMessage::LsaDelta::Print (std::ostream &os) const
+{
+  os << "LsaDelta:: base " << baseSeq << "\n";
+  for (unsigned i = 0; i < changed.size (); i++)
+    {
+      os << "+" << changed[i].first << ":" << changed[i].second << "\n";
+    }
+  for (unsigned i = 0; i < removed.size (); i++)
+    {
+      os << "-" << removed[i] << "\n";
+    }
+}
+
+void
+LSMessage::LsaDelta::Serialize (Buffer::Iterator &start) const
+{
+  start.WriteU8 (LS_LSA_ENCODING_VERSION);
+  WriteVarint (start, baseSeq);
+  WriteVarint (start, changed.size ());
+  for (unsigned i = 0; i < changed.size (); i++)
+    {
+      WriteVarint (start, changed[i].first);
+      WriteVarint (start, changed[i].second);
+    }
+  WriteVarint (start, removed.size ());
+  for (unsigned i = 0; i < removed.size (); i++)
+    {
+      WriteVarint (start, removed[i]);
+    }
+}
+
+uint32_t
+LSMessage::LsaDelta::Deserialize (Buffer::Iterator &start)
+{
+  Buffer::Iterator begin = start;
+  if (start.GetRemainingSize () == 0)
+    {
+      return 0;
+    }
+  uint8_t version = start.ReadU8 ();
+  uint32_t length;
+  if (version < 1 || version > LS_LSA_ENCODING_VERSION || !ReadVarint (start, baseSeq)
+      || !ReadVarint (start, length) || length > start.GetRemainingSize () / 2)
+    {
+      return 0;
+    }
+  changed.clear ();
+  changed.reserve (length);
+  for (unsigned i = 0; i < length; i++)
+    {
+      uint32_t neighborNodeNum;
+      uint32_t linkwt;
+      if (!ReadVarint (start, neighborNodeNum) || !ReadVarint (start, linkwt))
+        {
+          return 0;
+        }
+      changed.push_back (std::make_pair (neighborNodeNum, linkwt));
+    }
+  // Removed entries are a single varint each.
+  if (!ReadVarint (start, length) || length > start.GetRemainingSize ())
+    {
+      return 0;
+    }
+  removed.clear ();
+  removed.reserve (length);
+  for (unsigned i = 0; i < length; i++)
+    {
+      uint32_t neighborNodeNum;
+      if (!ReadVarint (start, neighborNodeNum))
+        {
+          return 0;
+        }
+      removed.push_back (neighborNodeNum);
+    }
+  return start.GetDistanceFrom (begin);
+}
+
+void
+LSMessage::SetLsaDelta (uint32_t baseSeq, neighborInfo changed, std::vector<uint32_t> removed)
+{
+  if (m_messageType == 0)
+    {
+      m_messageType = LSA_DELTA;
+    }
+  else
+    {
+      NS_ASSERT (m_messageType == LSA_DELTA);
+    }
+  m_message.lsaDelta.baseSeq = baseSeq;
+  m_message.lsaDelta.changed = std::move (changed);
+  m_message.lsaDelta.removed = std::move (removed);
+}
+
+const LSMessage::LsaDelta &
+LSMessage::GetLsaDelta () const
+{
+  return m_message.lsaDelta;
+}
+
+/* DB_DESC */
+
+uint32_t
+LSMessage::DbDesc::GetSerializedSize (void) const
+{
+  return sizeof (uint16_t) + (IPV4_ADDRESS_SIZE + sizeof (uint32_t)) * summaries.size ();
+}
+
+void
+LSMessage::DbDesc::Print (std::ostream &os) const
+{
+  os << "DbDesc:: ";
+  for (unsigned i = 0; i < summaries.size (); i++)
+    {
+      os << Ipv4Address (summaries[i].first) << ":" << summaries[i].second << "\n";
+    }
+}
+
+void
+LSMessage::DbDesc::Serialize (Buffer::Iterator &start) const
+{
+  start.WriteU16 (summaries.size ());
+  for (unsigned i = 0; i < summaries.size (); i++)
+    {
+      start.WriteHtonU32 (summaries[i].first);
+      start.WriteHtonU32 (summaries[i].second);
+    }
+}
+
+uint32_t
+LSMessage::DbDesc::Deserialize (Buffer::Iterator &start)
+{
+  if (start.GetRemainingSize () < sizeof (uint16_t))
+    {
+      return 0;
+    }
+  uint16_t length = start.ReadU16 ();
+  if (start.GetRemainingSize () < length * 2 * sizeof (uint32_t))
+    {
+      return 0;
+    }
+  summaries.clear ();
+  summaries.reserve (length);
+  for (unsigned i = 0; i < length; i++)
+    {
+      uint32_t originator = start.ReadNtohU32 ();
+      uint32_t seq = start.ReadNtohU32 ();
+      summaries.push_back (std::make_pair (originator, seq));
+    }
+  return DbDesc::GetSerializedSize ();
+}
+
+void
+LSMessage::SetDbDesc (lsaKeys summaries)
+{
+  if (m_messageType == 0)
+    {
+      m_messageType = DB_DESC;
+    }
+  else
+    {
+      NS_ASSERT (m_messageType == DB_DESC);
+    }
+  m_message.dbDesc.summaries = std::move (summaries);
+}
+
+const LSMessage::DbDesc &
+LSMessage::GetDbDesc () const
+{
+  return m_message.dbDesc;
+}
+
+/* LSA_REQ */
+
+uint32_t
+LSMessage::LsaReq::GetSerializedSize (void) const
+{
+  return sizeof (uint16_t) + (IPV4_ADDRESS_SIZE + sizeof (uint32_t)) * requests.size ();
+}
+
+void
+LSMessage::LsaReq::Print (std::ostream &os) const
+{
+  os << "LsaReq:: ";
+  for (unsigned i = 0; i < requests.size (); i++)
+    {
+      os << Ipv4Address (requests[i].first) << ":" << requests[i].second << "\n";
+    }
+}
+
+void
+LSMessage::LsaReq::Serialize (Buffer::Iterator &start) const
+{
+  start.WriteU16 (requests.size ());
+  for (unsigned i = 0; i < requests.size (); i++)
+    {
+      start.WriteHtonU32 (requests[i].first);
+      start.WriteHtonU32 (requests[i].second);
+    }
+}
+
+uint32_t
+LSMessage::LsaReq::Deserialize (Buffer::Iterator &start)
+{
+  if (start.GetRemainingSize () < sizeof (uint16_t))
+    {
+      return 0;
+    }
+  uint16_t length = start.ReadU16 ();
+  if (start.GetRemainingSize () < length * 2 * sizeof (uint32_t))
+    {
+      return 0;
+    }
+  requests.clear ();
+  requests.reserve (length);
+  for (unsigned i = 0; i < length; i++)
+    {
+      uint32_t originator = start.ReadNtohU32 ();
+      uint32_t seq = start.ReadNtohU32 ();
+      requests.push_back (std::make_pair (originator, seq));
+    }
+  return LsaReq::GetSerializedSize ();
+}
+
+void
+LSMessage::SetLsaReq (lsaKeys requests)
+{
+  if (m_messageType == 0)
+    {
+      m_messageType = LSA_REQ;
+    }
+  else
+    {
+      NS_ASSERT (m_messageType == LSA_REQ);
+    }
+  m_message.lsaReq.requests = std::move (requests);
+}
+
+const LSMessage::LsaReq &
+LSMessage::GetLsaReq () const
+{
+  return m_message.lsaReq;
+}
+
+/* GRACE */
+
+uint32_t
+LSMessage::Grace::GetSerializedSize (void) const
+{
+  return sizeof (uint32_t);
+}
+
+void
+LSMessage::Grace::Print (std::ostream &os) const
+{
+  os << "Grace:: period " << gracePeriod << " ms\n";
+}
+
+void
+LSMessage::Grace::Serialize (Buffer::Iterator &start) const
+{
+  start.WriteHtonU32 (gracePeriod);
+}
+
+uint32_t
+LSMessage::Grace::Deserialize (Buffer::Iterator &start)
+{
+  if (start.GetRemainingSize () < sizeof (uint32_t))
+    {
+      return 0;
+    }
+  gracePeriod = start.ReadNtohU32 ();
+  return Grace::GetSerializedSize ();
+}
+
+void
+LSMessage::SetGrace (uint32_t gracePeriod)
+{
+  if (m_messageType == 0)
+    {
+      m_messageType = GRACE;
+    }
+  else
+    {
+      NS_ASSERT (m_messageType == GRACE);
+    }
+  m_message.grace.gracePeriod = gracePeriod;
+}
+
+const LSMessage::Grace &
+LSMessage::GetGrace () const
+{
+  return m_message.grace;
+}
+
+/* LS_UPDATE */
+
+uint32_t
+LSMessage::LsUpdate::GetSerializedSize (void) const
+{
+  return sizeof (uint16_t);
+}
+
+void
+LSMessage::LsUpdate::Print (std::ostream &os) const
+{
+  os << "LsUpdate:: " << lsaCount << " LSAs\n";
+}
+
+void
+LSMessage::LsUpdate::Serialize (Buffer::Iterator &start) const
+{
+  start.WriteHtonU16 (lsaCount);
+}
+
+uint32_t
+LSMessage::LsUpdate::Deserialize (Buffer::Iterator &start)
+{
+  if (start.GetRemainingSize () < sizeof (uint16_t))
+    {
+      return 0;
+    }
+  lsaCount = start.ReadNtohU16 ();
+  return LsUpdate::GetSerializedSize ();
+}
+
+void
+LSMessage::SetLsUpdate (uint16_t lsaCount)
+{
+  if (m_messageType == 0)
+    {
+      m_messageType = LS_UPDATE;
+    }
+  else
+    {
+      NS_ASSERT (m_messageType == LS_UPDATE);
+    }
+  m_message.lsUpdate.lsaCount = lsaCount;
+}
+
+const LSMessage::LsUpdate &
+LSMessage::GetLsUpdate () const
+{
+  return m_message.lsUpdate;
+}
 
 
 /* PING_RSP */
@@ -431,24 +1080,36 @@ LSMessage::HelloRsp::Serialize (Buffer::Iterator &start) const
 uint32_t
 LSMessage::PingRsp::Deserialize (Buffer::Iterator &start)
 {
+  if (start.GetRemainingSize () < IPV4_ADDRESS_SIZE + sizeof (uint16_t))
+    {
+      return 0;
+    }
   destinationAddress = Ipv4Address (start.ReadNtohU32 ());
   uint16_t length = start.ReadU16 ();
-  char *str = (char *)malloc (length);
-  start.Read ((uint8_t *)str, length);
-  pingMessage = std::string (str, length);
-  free (str);
+  if (start.GetRemainingSize () < length)
+    {
+      return 0;
+    }
+  pingMessage.resize (length);
+  start.Read ((uint8_t *)&pingMessage[0], length);
   return PingRsp::GetSerializedSize ();
 }
 // ************************* new *********************** //
 uint32_t
 LSMessage::HelloRsp::Deserialize (Buffer::Iterator &start)
 {
+  if (start.GetRemainingSize () < IPV4_ADDRESS_SIZE + sizeof (uint16_t))
+    {
+      return 0;
+    }
   destinationAddress = Ipv4Address (start.ReadNtohU32 ());
   uint16_t length = start.ReadU16 ();
-  char *str = (char *)malloc (length);
-  start.Read ((uint8_t *)str, length);
-  helloMessage = std::string (str, length);
-  free (str);
+  if (start.GetRemainingSize () < length)
+    {
+      return 0;
+    }
+  helloMessage.resize (length);
+  start.Read ((uint8_t *)&helloMessage[0], length);
   return HelloRsp::GetSerializedSize ();
 }
 
@@ -464,7 +1125,7 @@ LSMessage::SetPingRsp (Ipv4Address destinationAddress, std::string pingMessage)
       NS_ASSERT (m_messageType == PING_RSP);
     }
   m_message.pingRsp.destinationAddress = destinationAddress;
-  m_message.pingRsp.pingMessage = pingMessage;
+  m_message.pingRsp.pingMessage = std::move (pingMessage);
 }
 // ************************* new *********************** //
 void
@@ -479,12 +1140,12 @@ LSMessage::SetHelloRsp (Ipv4Address destinationAddress, std::string helloMessage
       NS_ASSERT (m_messageType == HELLO_RSP);
     }
   m_message.helloRsp.destinationAddress = destinationAddress;
-  m_message.helloRsp.helloMessage = helloMessage;
+  m_message.helloRsp.helloMessage = std::move (helloMessage);
 }
 
 
-LSMessage::PingRsp
-LSMessage::GetPingRsp ()
+const LSMessage::PingRsp &
+LSMessage::GetPingRsp () const
 {
   return m_message.pingRsp;
 }
@@ -492,8 +1153,8 @@ LSMessage::GetPingRsp ()
 // TODO: You can put your own Rsp/Req related function here
 
 // ************************* new *********************** //
-LSMessage::HelloRsp
-LSMessage::GetHelloRsp()
+const LSMessage::HelloRsp &
+LSMessage::GetHelloRsp () const
 {
   return m_message.helloRsp;
 }
@@ -26,6 +26,9 @@
 using namespace ns3;
 
 #define IPV4_ADDRESS_SIZE 4
+/// Version byte leading every LSA and LSA delta payload
+/// (1: varint encoding, 2: LSAs also carry inter-area summaries)
+#define LS_LSA_ENCODING_VERSION 2
 
 class LSMessage : public Header
   {
@@ -41,6 +44,13 @@ class LSMessage : public Header
       HELLO_REQ,  // new
       HELLO_RSP,  // new 
       LSA_m,  //new
+      LSA_ACK,
+      DB_DESC,
+      LSA_REQ,
+      LSA_DELTA,
+      BFD_HELLO,  // fast liveness probe, header only
+      GRACE,      // graceful restart announcement
+      LS_UPDATE,  // several LSAs in one datagram
       };
 
     LSMessage(LSMessage::MessageType messageType, uint32_t sequenceNumber, uint8_t ttl, Ipv4Address originatorAddress);
@@ -165,6 +175,82 @@ class LSMessage : public Header
       // Payload
       //Ipv4Address destinationAddress;
       neighborInfo lsaMessage;
+      // Area border routers only: destinations outside the LSA's area, with
+      // the originator's cost to reach them
+      neighborInfo summaries;
+      };
+
+    // Adjacencies added, changed and removed since LSA baseSeq of the same originator
+    struct LsaDelta
+      {
+      void Print(std::ostream& os) const;
+      uint32_t GetSerializedSize(void) const;
+      void Serialize(Buffer::Iterator& start) const;
+      uint32_t Deserialize(Buffer::Iterator& start);
+      // Payload
+      uint32_t baseSeq;
+      neighborInfo changed;
+      std::vector<uint32_t> removed;
+      };
+
+    // (originator address, sequence number) of an LSA
+    typedef std::vector<std::pair<uint32_t, uint32_t>> lsaKeys;
+
+    struct LsaAck
+      {
+      void Print(std::ostream& os) const;
+      uint32_t GetSerializedSize(void) const;
+      void Serialize(Buffer::Iterator& start) const;
+      uint32_t Deserialize(Buffer::Iterator& start);
+      // Payload
+      lsaKeys acks;
+      };
+
+    // Summary of a node's LSDB, sent to a neighbor on adjacency-up
+    struct DbDesc
+      {
+      void Print(std::ostream& os) const;
+      uint32_t GetSerializedSize(void) const;
+      void Serialize(Buffer::Iterator& start) const;
+      uint32_t Deserialize(Buffer::Iterator& start);
+      // Payload
+      lsaKeys summaries;
+      };
+
+    // LSAs missing from the requester's LSDB, or older there
+    struct LsaReq
+      {
+      void Print(std::ostream& os) const;
+      uint32_t GetSerializedSize(void) const;
+      void Serialize(Buffer::Iterator& start) const;
+      uint32_t Deserialize(Buffer::Iterator& start);
+      // Payload
+      lsaKeys requests;
+      };
+
+    // Sent by a restarting node: keep the adjacency up for gracePeriod while
+    // it resyncs.  A zero period ends the restart.
+    struct Grace
+      {
+      void Print(std::ostream& os) const;
+      uint32_t GetSerializedSize(void) const;
+      void Serialize(Buffer::Iterator& start) const;
+      uint32_t Deserialize(Buffer::Iterator& start);
+      // Payload
+      uint32_t gracePeriod; // milliseconds
+      };
+
+    // Leads a batch of LSAs (LSA_m or LSA_DELTA messages) that follow it in
+    // the same packet as headers of their own, so a batch is assembled from
+    // already serialized LSAs without encoding them again.
+    struct LsUpdate
+      {
+      void Print(std::ostream& os) const;
+      uint32_t GetSerializedSize(void) const;
+      void Serialize(Buffer::Iterator& start) const;
+      uint32_t Deserialize(Buffer::Iterator& start);
+      // Payload
+      uint16_t lsaCount;
       };
 
    
@@ -178,6 +264,12 @@ class LSMessage : public Header
       HelloReq helloReq;
       HelloRsp helloRsp;
       LsA lsA;
+      LsaAck lsaAck;
+      DbDesc dbDesc;
+      LsaReq lsaReq;
+      LsaDelta lsaDelta;
+      Grace grace;
+      LsUpdate lsUpdate;
       } m_message;
     
 
@@ -186,10 +278,20 @@ class LSMessage : public Header
     /**
      *  \returns PingReq Struct
      */
-    PingReq GetPingReq();
+    const PingReq &GetPingReq() const;
     //******************* new ******************//
-    HelloReq GetHelloReq();
-    LsA GetLsA();
+    const HelloReq &GetHelloReq() const;
+    const LsA &GetLsA() const;
+    /**
+     *  \returns LsA Struct, so that a receiver can move the adjacency out
+     */
+    LsA &GetLsA();
+    const LsaAck &GetLsaAck() const;
+    const DbDesc &GetDbDesc() const;
+    const LsaReq &GetLsaReq() const;
+    const LsaDelta &GetLsaDelta() const;
+    const Grace &GetGrace() const;
+    const LsUpdate &GetLsUpdate() const;
     /**
      *  \brief Sets PingReq message params
      *  \param message Payload String
@@ -197,13 +299,19 @@ class LSMessage : public Header
 
     void SetPingReq(Ipv4Address destinationAddress, std::string message);
     void SetHelloReq(Ipv4Address destinationAddress, std::string message); //**** new ****//
-    void SetLsA (neighborInfo lsaMessage);
+    void SetLsA (neighborInfo lsaMessage, neighborInfo summaries = neighborInfo ());
+    void SetLsaAck (lsaKeys acks);
+    void SetDbDesc (lsaKeys summaries);
+    void SetLsaReq (lsaKeys requests);
+    void SetLsaDelta (uint32_t baseSeq, neighborInfo changed, std::vector<uint32_t> removed);
+    void SetGrace (uint32_t gracePeriod);
+    void SetLsUpdate (uint16_t lsaCount);
     /**
      * \returns PingRsp Struct
      */
-    PingRsp GetPingRsp();
+    const PingRsp &GetPingRsp() const;
     //******************* new ******************//
-    HelloRsp GetHelloRsp();
+    const HelloRsp &GetHelloRsp() const;
     /**
      *  \brief Sets PingRsp message params
      *  \param message Payload String
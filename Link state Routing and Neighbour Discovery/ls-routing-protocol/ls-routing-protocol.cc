@@ -15,21 +15,38 @@
  */
 
 #include "ns3/ls-routing-protocol.h"
+#include "ns3/boolean.h"
 #include "ns3/double.h"
 #include "ns3/inet-socket-address.h"
 #include "ns3/ipv4-header.h"
 #include "ns3/ipv4-packet-info-tag.h"
 #include "ns3/ipv4-route.h"
+#include "ns3/ipv4-routing-table-entry.h"
 #include "ns3/log.h"
 #include "ns3/random-variable-stream.h"
 #include "ns3/simulator.h"
 #include "ns3/socket-factory.h"
+#include "ns3/string.h"
 #include "ns3/test-result.h"
+#include "ns3/trace-source-accessor.h"
 #include "ns3/udp-socket-factory.h"
 #include "ns3/uinteger.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
 #include <ctime>
+#include <fstream>
+#include <functional>
 #include <iostream>
+#include <limits>
+#include <queue>
 #include <string>
+#include <unordered_map>
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 using namespace ns3;
@@ -42,6 +59,30 @@ NS_OBJECT_ENSURE_REGISTERED(LSRoutingProtocol);
 /// Maximum allowed sequence number
 #define LS_MAX_SEQUENCE_NUMBER 0xFFFF
 #define LS_PORT_NUMBER 698
+/// Cost of a node not (yet) reached by SPF
+#define LS_INFINITY std::numeric_limits<uint32_t>::max()
+/// Placeholder for "no parent / no next hop" in the SPF arrays
+#define LS_NO_NODE std::numeric_limits<uint32_t>::max()
+/// IPv4 plus UDP header bytes in front of every LS message
+#define LS_IP_UDP_OVERHEAD 28
+/// Area every other area attaches to through its border routers
+#define LS_BACKBONE_AREA 0
+/// SendOnInterfaces() area for packets not scoped to one area
+#define LS_ALL_AREAS std::numeric_limits<uint32_t>::max()
+/// First two words of an LSDB snapshot file ("LSS1" and the format version)
+#define LS_SNAPSHOT_MAGIC 0x4c535331
+#define LS_SNAPSHOT_VERSION 2
+/// Entries of the per-type message counters (LSMessage::LS_UPDATE is the last type)
+#define LS_MESSAGE_TYPES (LSMessage::LS_UPDATE + 1)
+/// Buckets of the SPF wall time histogram; the last one also holds anything slower
+#define LS_SPF_HISTOGRAM_BUCKETS 24
+/// Rough per-entry cost of a std::map node (three pointers and the color)
+#define LS_MAP_NODE_OVERHEAD 32
+
+/// Names of the message types in DUMP STATS, indexed by LSMessage::MessageType
+static const char *const LS_MESSAGE_TYPE_NAMES[LS_MESSAGE_TYPES] = {
+    "PING_REQ", "PING_RSP", "HELLO_REQ", "HELLO_RSP", "LSA", "LSA_ACK",
+    "DB_DESC", "LSA_REQ", "LSA_DELTA", "BFD_HELLO", "GRACE", "LS_UPDATE"};
 
 
 //std::map<uint32_t, RoutingTableEntry> m_routingTable;
@@ -62,16 +103,127 @@ LSRoutingProtocol::GetTypeId(void)
                           .AddAttribute("PingTimeout", "Timeout value for PING_REQ in milliseconds", TimeValue(MilliSeconds(2000)),
                                         MakeTimeAccessor(&LSRoutingProtocol::m_pingTimeout), MakeTimeChecker())
                           .AddAttribute("MaxTTL", "Maximum TTL value for LS packets", UintegerValue(16),
-                                        MakeUintegerAccessor(&LSRoutingProtocol::m_maxTTL), MakeUintegerChecker<uint8_t>());
+                                        MakeUintegerAccessor(&LSRoutingProtocol::m_maxTTL), MakeUintegerChecker<uint8_t>())
+                          .AddAttribute("MaxEcmpPaths", "Maximum number of equal-cost next hops kept per destination (0 = no limit)",
+                                        UintegerValue(4),
+                                        MakeUintegerAccessor(&LSRoutingProtocol::m_maxEcmpPaths), MakeUintegerChecker<uint32_t>())
+                          .AddAttribute("SpfThreads", "Threads used by full SPF runs; more than one selects the parallel delta-stepping backend. "
+                                        "Full runs are the first one and those after large change sets; other runs repair the tree serially",
+                                        UintegerValue(1),
+                                        MakeUintegerAccessor(&LSRoutingProtocol::m_spfThreads), MakeUintegerChecker<uint32_t>(1))
+                          .AddAttribute("LoopFreeAlternates", "Precompute loop-free alternate next hops and switch to them when a neighbor is lost",
+                                        BooleanValue(true),
+                                        MakeBooleanAccessor(&LSRoutingProtocol::m_lfaEnabled), MakeBooleanChecker())
+                          .AddAttribute("LsaMinInterval", "Minimum time between two originations of our own LSA",
+                                        TimeValue(Seconds(1)),
+                                        MakeTimeAccessor(&LSRoutingProtocol::m_lsaMinInterval), MakeTimeChecker())
+                          .AddAttribute("LsaRefreshInterval", "Period at which our LSA is re-flooded when nothing has changed",
+                                        TimeValue(Seconds(60)),
+                                        MakeTimeAccessor(&LSRoutingProtocol::m_lsaRefreshInterval), MakeTimeChecker())
+                          .AddAttribute("LsaMaxAge", "Age at which an LSA that has not been refreshed is removed from the LSDB",
+                                        TimeValue(Seconds(180)),
+                                        MakeTimeAccessor(&LSRoutingProtocol::m_lsaMaxAge), MakeTimeChecker())
+                          .AddAttribute("LsaRetransmitInterval", "Time after which an unacknowledged LSA is sent to a neighbor again",
+                                        TimeValue(Seconds(1)),
+                                        MakeTimeAccessor(&LSRoutingProtocol::m_lsaRetransmitInterval), MakeTimeChecker())
+                          .AddAttribute("LsaAckDelay", "Time acks are held so that several can share one LSA_ACK packet",
+                                        TimeValue(MilliSeconds(100)),
+                                        MakeTimeAccessor(&LSRoutingProtocol::m_lsaAckDelay), MakeTimeChecker())
+                          .AddAttribute("BfdInterval", "Interval of the per-neighbor fast hellos; zero disables them",
+                                        TimeValue(MilliSeconds(100)),
+                                        MakeTimeAccessor(&LSRoutingProtocol::m_bfdInterval), MakeTimeChecker())
+                          .AddAttribute("BfdDetectMultiplier", "Fast hello intervals without a hello before a neighbor is declared down",
+                                        UintegerValue(3),
+                                        MakeUintegerAccessor(&LSRoutingProtocol::m_bfdMultiplier),
+                                        MakeUintegerChecker<uint32_t>(1))
+                          .AddAttribute("TimerWheelTick", "Resolution of the neighbor, ping and LSA expiry timers",
+                                        TimeValue(MilliSeconds(50)),
+                                        MakeTimeAccessor(&LSRoutingProtocol::m_wheelTick),
+                                        MakeTimeChecker(NanoSeconds(1)))
+                          .AddAttribute("LinkCostUnit", "Measured round-trip time that corresponds to one unit of link cost",
+                                        TimeValue(MilliSeconds(1)),
+                                        MakeTimeAccessor(&LSRoutingProtocol::m_linkCostUnit), MakeTimeChecker())
+                          .AddAttribute("RttSmoothing", "Weight of a new RTT sample in the smoothed per-neighbor RTT",
+                                        DoubleValue(0.125),
+                                        MakeDoubleAccessor(&LSRoutingProtocol::m_rttAlpha), MakeDoubleChecker<double>(0.0, 1.0))
+                          .AddAttribute("LinkCostHysteresis", "Relative change of the measured cost needed before it is advertised",
+                                        DoubleValue(0.25),
+                                        MakeDoubleAccessor(&LSRoutingProtocol::m_linkCostHysteresis), MakeDoubleChecker<double>(0.0))
+                          .AddAttribute("SpfInitialDelay", "Delay before running SPF after the first change in a quiet period",
+                                        TimeValue(MilliSeconds(50)),
+                                        MakeTimeAccessor(&LSRoutingProtocol::m_spfInitialDelay), MakeTimeChecker())
+                          .AddAttribute("SpfHoldTime", "Minimum spacing between consecutive SPF runs; doubles while changes keep arriving",
+                                        TimeValue(MilliSeconds(200)),
+                                        MakeTimeAccessor(&LSRoutingProtocol::m_spfHoldTime), MakeTimeChecker())
+                          .AddAttribute("SpfMaxWait", "Upper bound for the SPF hold time under sustained churn",
+                                        TimeValue(Seconds(5)),
+                                        MakeTimeAccessor(&LSRoutingProtocol::m_spfMaxWait), MakeTimeChecker())
+                          .AddAttribute("SnapshotFile", "File the LSDB snapshot is kept in, one per node; empty disables graceful restart",
+                                        StringValue(""),
+                                        MakeStringAccessor(&LSRoutingProtocol::m_snapshotFile), MakeStringChecker())
+                          .AddAttribute("SnapshotInterval", "Time between two LSDB snapshots",
+                                        TimeValue(Seconds(10)),
+                                        MakeTimeAccessor(&LSRoutingProtocol::m_snapshotInterval), MakeTimeChecker())
+                          .AddAttribute("GracePeriod", "How long neighbors keep forwarding through a restarting node while it resyncs",
+                                        TimeValue(Seconds(30)),
+                                        MakeTimeAccessor(&LSRoutingProtocol::m_gracePeriod), MakeTimeChecker())
+                          .AddTraceSource("Tx", "An LS control packet is sent, once per interface or neighbor",
+                                          MakeTraceSourceAccessor(&LSRoutingProtocol::m_txTrace),
+                                          "LSRoutingProtocol::MessageTracedCallback")
+                          .AddTraceSource("Rx", "An LS control packet is received",
+                                          MakeTraceSourceAccessor(&LSRoutingProtocol::m_rxTrace),
+                                          "LSRoutingProtocol::MessageTracedCallback")
+                          .AddTraceSource("Spf", "An SPF computation finished",
+                                          MakeTraceSourceAccessor(&LSRoutingProtocol::m_spfTrace),
+                                          "LSRoutingProtocol::SpfTracedCallback")
+                          .AddTraceSource("Flood", "An LSA is flooded",
+                                          MakeTraceSourceAccessor(&LSRoutingProtocol::m_floodTrace),
+                                          "LSRoutingProtocol::FloodTracedCallback")
+                          .AddTraceSource("LsdbSize", "LSAs held in all areas, sampled after each SPF run",
+                                          MakeTraceSourceAccessor(&LSRoutingProtocol::m_lsdbSize),
+                                          "ns3::TracedValueCallback::Uint32")
+                          .AddTraceSource("LsdbMemory", "Approximate bytes held by the LSDBs and SPF engines",
+                                          MakeTraceSourceAccessor(&LSRoutingProtocol::m_lsdbMemory),
+                                          "ns3::TracedValueCallback::Uint64")
+                          .AddTraceSource("RouteChanges", "Primary paths of installed routes added, changed or withdrawn",
+                                          MakeTraceSourceAccessor(&LSRoutingProtocol::m_routeChanges),
+                                          "ns3::TracedValueCallback::Uint64");
   return tid;
 }
 
 LSRoutingProtocol::LSRoutingProtocol()
-    : m_auditPingsTimer(Timer::CANCEL_ON_DESTROY),
-    m_auditNeighborsTimer(Timer:: CANCEL_ON_DESTROY)
+    : m_auditNeighborsTimer(Timer:: CANCEL_ON_DESTROY),
+    m_spfTimer(Timer::CANCEL_ON_DESTROY),
+    m_lsaOriginateTimer(Timer::CANCEL_ON_DESTROY),
+    m_lsaRefreshTimer(Timer::CANCEL_ON_DESTROY),
+    m_retransmitTimer(Timer::CANCEL_ON_DESTROY),
+    m_ackTimer(Timer::CANCEL_ON_DESTROY),
+    m_bfdTimer(Timer::CANCEL_ON_DESTROY),
+    m_wheelTimer(Timer::CANCEL_ON_DESTROY),
+    m_snapshotTimer(Timer::CANCEL_ON_DESTROY),
+    m_graceTimer(Timer::CANCEL_ON_DESTROY)
 {
 
   m_currentSequenceNumber = 0;
+  m_lsaSequenceNumber = 0;
+  m_lsaReceivedCount = 0;
+  m_fullLsaDue = true;
+  m_restarting = false;
+  m_spfRunCount = 0;
+  m_spfCpuSeconds = 0;
+  m_neighborTimeout = Seconds(5.0);
+  m_controlTxBytes = 0;
+  m_controlRateSampleBytes = 0;
+  m_controlBytesPerSecond = 0;
+  m_messageCounters.assign(LS_MESSAGE_TYPES, MessageCounters());
+  m_spfHistogram.assign(LS_SPF_HISTOGRAM_BUCKETS, 0);
+  m_floodCount = 0;
+  m_floodFanout = 0;
+  m_malformedPackets = 0;
+  m_malformedBytes = 0;
+  m_lsdbSize = 0;
+  m_lsdbMemory = 0;
+  m_routeChanges = 0;
   // Setup static routing
   m_staticRouting = Create<Ipv4StaticRouting>();
 }
@@ -95,12 +247,24 @@ void LSRoutingProtocol::DoDispose()
   m_socketAddresses.clear();
 
   // Clear static routing
+  m_installedRoutes.clear();
+  m_fib.Clear();
   m_staticRouting = 0;
 
   // Cancel timers
-  m_auditPingsTimer.Cancel();
+  m_wheelTimer.Cancel();
   m_pingTracker.clear();
   m_auditNeighborsTimer.Cancel();
+  m_spfTimer.Cancel();
+  m_lsaOriginateTimer.Cancel();
+  m_lsaRefreshTimer.Cancel();
+  m_retransmitTimer.Cancel();
+  m_ackTimer.Cancel();
+  m_bfdTimer.Cancel();
+  m_snapshotTimer.Cancel();
+  m_graceTimer.Cancel();
+  m_timerWheel.Clear();
+  m_areas.clear();
   //m_pingTracker.clear();
 
   PennRoutingProtocol::DoDispose();
@@ -114,32 +278,81 @@ void LSRoutingProtocol::SetMainInterface(uint32_t mainInterface)
 void LSRoutingProtocol::SetNodeAddressMap(std::map<uint32_t, Ipv4Address> nodeAddressMap)
 {
   m_nodeAddressMap = nodeAddressMap;
+  // Node numbers are ns-3 node ids, dense from 0, so a vector indexed by
+  // node number is the reverse table.
+  m_nodeAddressTable.clear();
+  if (!m_nodeAddressMap.empty())
+  {
+    m_nodeAddressTable.assign(m_nodeAddressMap.rbegin()->first + 1, Ipv4Address::GetAny());
+  }
+  for (std::map<uint32_t, Ipv4Address>::iterator iter = m_nodeAddressMap.begin(); iter != m_nodeAddressMap.end(); iter++)
+  {
+    m_nodeAddressTable[iter->first] = iter->second;
+  }
 }
 
 void LSRoutingProtocol::SetAddressNodeMap(std::map<Ipv4Address, uint32_t> addressNodeMap)
 {
   m_addressNodeMap = addressNodeMap;
+  m_addressNodeTable.clear();
+  m_addressNodeTable.reserve(m_addressNodeMap.size());
+  for (std::map<Ipv4Address, uint32_t>::iterator iter = m_addressNodeMap.begin(); iter != m_addressNodeMap.end(); iter++)
+  {
+    m_addressNodeTable[iter->first.Get()] = iter->second;
+  }
 }
 
 Ipv4Address
 LSRoutingProtocol::ResolveNodeIpAddress(uint32_t nodeNumber)
 {
-  std::map<uint32_t, Ipv4Address>::iterator iter = m_nodeAddressMap.find(nodeNumber);
-  if (iter != m_nodeAddressMap.end())
+  if (nodeNumber < m_nodeAddressTable.size())
   {
-    return iter->second;
+    return m_nodeAddressTable[nodeNumber];
   }
   return Ipv4Address::GetAny();
 }
 
+bool LSRoutingProtocol::LookupNode(Ipv4Address ipAddress, uint32_t &nodeNumber) const
+{
+  std::unordered_map<uint32_t, uint32_t>::const_iterator iter = m_addressNodeTable.find(ipAddress.Get());
+  if (iter == m_addressNodeTable.end())
+  {
+    return false;
+  }
+  nodeNumber = iter->second;
+  return true;
+}
+
+uint32_t LSRoutingProtocol::GetSelfNode() const
+{
+  uint32_t selfNode = LS_NO_NODE;
+  LookupNode(m_mainAddress, selfNode);
+  return selfNode;
+}
+
+void LSRoutingProtocol::SetInterfaceArea(uint32_t interface, uint32_t area)
+{
+  m_interfaceArea[interface] = area;
+}
+
+uint32_t LSRoutingProtocol::GetArea(Ipv4Address interfaceAddr) const
+{
+  int32_t interface = m_ipv4->GetInterfaceForAddress(interfaceAddr);
+  std::map<uint32_t, uint32_t>::const_iterator iter = m_interfaceArea.find((uint32_t)interface);
+  if (interface < 0 || iter == m_interfaceArea.end())
+  {
+    return LS_BACKBONE_AREA;
+  }
+  return iter->second;
+}
+
 std::string
 LSRoutingProtocol::ReverseLookup(Ipv4Address ipAddress)
 {
-  std::map<Ipv4Address, uint32_t>::iterator iter = m_addressNodeMap.find(ipAddress);
-  if (iter != m_addressNodeMap.end())
+  uint32_t nodeNumber;
+  if (LookupNode(ipAddress, nodeNumber))
   {
     std::ostringstream sin;
-    uint32_t nodeNumber = iter->second;
     sin << nodeNumber;
     return sin.str();
   }
@@ -204,12 +417,50 @@ void LSRoutingProtocol::DoInitialize()
     m_socketAddresses[socket] = m_ipv4->GetAddress(i, 0);
     canRunLS = true;
   }
+  m_ownAddresses.clear();
+  for (std::map<Ptr<Socket>, Ipv4InterfaceAddress>::const_iterator iter = m_socketAddresses.begin();
+       iter != m_socketAddresses.end(); iter++)
+  {
+    m_ownAddresses.push_back(iter->second.GetLocal().Get());
+  }
+  std::sort(m_ownAddresses.begin(), m_ownAddresses.end());
+
+  // One LSDB and shortest path tree per area we have an interface in
+  for (std::map<Ptr<Socket>, Ipv4InterfaceAddress>::const_iterator iter = m_socketAddresses.begin();
+       iter != m_socketAddresses.end(); iter++)
+  {
+    m_areas[GetArea(iter->second.GetLocal())];
+  }
+  for (std::map<uint32_t, AreaState>::iterator iter = m_areas.begin(); iter != m_areas.end(); iter++)
+  {
+    iter->second.spf.SetMaxPaths(m_maxEcmpPaths);
+    iter->second.spf.SetThreads(m_spfThreads);
+  }
+
+  if (canRunLS && !m_snapshotFile.empty())
+  {
+    // A snapshot means we are restarting: forward on its routes right away
+    // and ask the neighbors to hold on to us while we resync.
+    if (LoadSnapshot())
+    {
+      m_restarting = true;
+      m_graceTimer.Schedule(m_gracePeriod);
+      SendGrace(m_gracePeriod);
+    }
+    if (m_snapshotInterval.IsStrictlyPositive())
+    {
+      m_snapshotTimer.Schedule(m_snapshotInterval);
+    }
+  }
 
   if (canRunLS)
   {
     AuditNeighbors();
     //BroadcastHello();
-    AuditPings();
+    if (m_bfdInterval.IsStrictlyPositive())
+    {
+      BfdTick();
+    }
     //LSAdvertise();
     NS_LOG_DEBUG("Starting LS on node " << m_mainAddress);
   }
@@ -224,7 +475,13 @@ Ptr<Ipv4Route>
 LSRoutingProtocol::RouteOutput(Ptr<Packet> packet, const Ipv4Header &header, Ptr<NetDevice> outInterface,
                                Socket::SocketErrno &sockerr)
 {
-  Ptr<Ipv4Route> ipv4Route = m_staticRouting->RouteOutput(packet, header, outInterface, sockerr);
+  Ptr<Ipv4Route> ipv4Route = m_fib.Lookup(header.GetDestination(), FlowHash(packet, header));
+  if (ipv4Route && (outInterface == 0 || ipv4Route->GetOutputDevice() == outInterface))
+  {
+    sockerr = Socket::ERROR_NOTERROR;
+    return ipv4Route;
+  }
+  ipv4Route = m_staticRouting->RouteOutput(packet, header, outInterface, sockerr);
   if (ipv4Route)
   {
     DEBUG_LOG("Found route to: " << ipv4Route->GetDestination() << " via next-hop: " << ipv4Route->GetGateway()
@@ -266,6 +523,13 @@ bool LSRoutingProtocol::RouteInput(Ptr<const Packet> packet, const Ipv4Header &h
     }
   }
 
+  Ptr<Ipv4Route> ipv4Route = m_fib.Lookup(destinationAddress, FlowHash(packet, header));
+  if (ipv4Route)
+  {
+    ucb(ipv4Route, packet, header);
+    return true;
+  }
+
   // Check static routing table
   if (m_staticRouting->RouteInput(packet, header, inputDev, ucb, mcb, lcb, ecb))
   {
@@ -276,15 +540,40 @@ bool LSRoutingProtocol::RouteInput(Ptr<const Packet> packet, const Ipv4Header &h
   return false;
 }
 
-void LSRoutingProtocol::BroadcastPacket(Ptr<Packet> packet)
+uint32_t
+LSRoutingProtocol::FlowHash(Ptr<const Packet> packet, const Ipv4Header &header) const
 {
-  for (std::map<Ptr<Socket>, Ipv4InterfaceAddress>::const_iterator i = m_socketAddresses.begin();
-       i != m_socketAddresses.end(); i++)
+  // Hash the 5-tuple so that all packets of a flow take the same equal-cost
+  // path.  Ports are read in place from the transport header when it is
+  // there (RouteOutput may be called before it is added, or without a packet).
+  uint32_t ports = 0;
+  uint8_t protocol = header.GetProtocol();
+  if (packet && (protocol == 6 || protocol == 17) && header.GetFragmentOffset() == 0 && packet->GetSize() >= 4)
   {
-    Ptr<Packet> pkt = packet->Copy();
-    Ipv4Address broadcastAddr = i->second.GetLocal().GetSubnetDirectedBroadcast(i->second.GetMask());
-    i->first->SendTo(pkt, 0, InetSocketAddress(broadcastAddr, LS_PORT_NUMBER));
+    uint8_t buf[4];
+    packet->CopyData(buf, 4);
+    ports = (uint32_t(buf[0]) << 24) | (uint32_t(buf[1]) << 16) | (uint32_t(buf[2]) << 8) | buf[3];
+  }
+
+  // Seeded with our own address so that neighboring routers do not all make
+  // the same choice for a flow.
+  uint32_t hash = m_mainAddress.Get();
+  uint32_t words[4] = {header.GetSource().Get(), header.GetDestination().Get(), protocol, ports};
+  for (unsigned int i = 0; i < 4; i++)
+  {
+    hash ^= words[i];
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6b;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35;
+    hash ^= hash >> 16;
   }
+  return hash;
+}
+
+void LSRoutingProtocol::BroadcastPacket(Ptr<Packet> packet)
+{
+  SendOnInterfaces(packet, Ipv4Address::GetAny(), LS_ALL_AREAS);
 }
 
 void LSRoutingProtocol::ProcessCommand(std::vector<std::string> tokens)
@@ -313,6 +602,7 @@ void LSRoutingProtocol::ProcessCommand(std::vector<std::string> tokens)
       Ptr<PingRequest> pingRequest = Create<PingRequest>(sequenceNumber, Simulator::Now(), destAddress, pingMessage);
       // Add to ping-tracker
       m_pingTracker.insert(std::make_pair(sequenceNumber, pingRequest));
+      ArmTimer(PING_TIMER, sequenceNumber, m_pingTimeout);
       Ptr<Packet> packet = Create<Packet>();
       LSMessage lsMessage = LSMessage(LSMessage::PING_REQ, sequenceNumber, m_maxTTL, m_mainAddress);
       lsMessage.SetPingReq(destAddress, pingMessage);
@@ -342,6 +632,20 @@ void LSRoutingProtocol::ProcessCommand(std::vector<std::string> tokens)
     {
       DumpLSA();
     }
+    else if (table == "STATS")
+    {
+      DumpStats();
+    }
+  }
+  else if (command == "GRACE")
+  {
+    // Planned restart: save the latest state and have the neighbors keep
+    // forwarding through us until we are back.
+    if (!m_snapshotFile.empty())
+    {
+      WriteSnapshot();
+    }
+    SendGrace(m_gracePeriod);
   }
 /*
   else if (command == "LINK" || command == "NODELINKS")
@@ -359,6 +663,44 @@ void LSRoutingProtocol::DumpLSA()
   PRINT_LOG("");
 }
 
+void LSRoutingProtocol::DumpStats()
+{
+  UpdateLsdbStats();
+  STATUS_LOG(std::endl
+             << "**************** LS Statistics ********************" << std::endl
+             << "MessageType\t\tTxPackets\t\tTxBytes\t\tRxPackets\t\tRxBytes");
+  for (uint32_t type = 0; type < m_messageCounters.size(); type++)
+  {
+    const MessageCounters &counters = m_messageCounters[type];
+    PRINT_LOG(LS_MESSAGE_TYPE_NAMES[type] << '\t' << counters.txPackets << '\t' << counters.txBytes << '\t'
+                                          << counters.rxPackets << '\t' << counters.rxBytes);
+  }
+
+  PRINT_LOG("SPF runs: " << m_spfRunCount << ", CPU seconds: " << m_spfCpuSeconds);
+  for (uint32_t i = 0; i < m_spfHistogram.size(); i++)
+  {
+    if (m_spfHistogram[i] == 0)
+    {
+      continue;
+    }
+    if (i + 1 == m_spfHistogram.size())
+    {
+      PRINT_LOG(">= " << (uint64_t(1) << (i - 1)) << " us\t" << m_spfHistogram[i]);
+    }
+    else
+    {
+      PRINT_LOG("< " << (uint64_t(1) << i) << " us\t" << m_spfHistogram[i]);
+    }
+  }
+
+  PRINT_LOG("LSDB: " << m_lsdbSize.Get() << " LSAs, " << m_lsdbMemory.Get() << " bytes");
+  PRINT_LOG("Floods: " << m_floodCount << ", mean fan-out: "
+                       << (m_floodCount > 0 ? double(m_floodFanout) / m_floodCount : 0.0));
+  PRINT_LOG("Malformed packets: " << m_malformedPackets << ", bytes dropped: " << m_malformedBytes);
+  PRINT_LOG("Routes: " << m_routingTable.size() << ", changes: " << m_routeChanges.Get()
+                       << ", last change: " << m_lastRouteChange.GetSeconds() << " s");
+}
+
 void LSRoutingProtocol::DumpNeighbors()
 {
   STATUS_LOG(std::endl
@@ -412,56 +754,93 @@ void LSRoutingProtocol::RecvLSMessage(Ptr<Socket> socket)
 {
   Address sourceAddr;
   Ptr<Packet> packet = socket->RecvFrom(sourceAddr);
-  LSMessage lsMessage;
   Ipv4PacketInfoTag interfaceInfo;
   if (!packet->RemovePacketTag(interfaceInfo))
   {
     NS_ABORT_MSG("No incoming interface on OLSR message, aborting.");
   }
   uint32_t incomingIf = interfaceInfo.GetRecvIf();
+  CountRx(packet);
 
-  if (!packet->RemoveHeader(lsMessage))
+  // The tag carries the device index; map it to the IPv4 interface and its
+  // address (socket map order says nothing about interface numbering).
+  Ipv4Address sender = InetSocketAddress::ConvertFrom(sourceAddr).GetIpv4();
+  Ipv4Address interface;
+  int32_t ipv4If = m_ipv4->GetInterfaceForDevice(GetObject<Node>()->GetDevice(incomingIf));
+  if (ipv4If >= 0)
   {
-    NS_ABORT_MSG("No incoming interface on LS message, aborting.");
+    interface = m_ipv4->GetAddress(ipv4If, 0).GetLocal();
   }
 
-  Ipv4Address interface;
-  uint32_t idx = 1;
-  for (std::map<Ptr<Socket>, Ipv4InterfaceAddress>::iterator iter = m_socketAddresses.begin();
-       iter != m_socketAddresses.end(); iter++)
+  // Batches of LSAs follow their LS_UPDATE header in the same packet, and
+  // ProcessLsUpdate() takes them off; anything after that is read here.
+  do
   {
-    if (idx == incomingIf)
+    LSMessage lsMessage;
+    if (packet->RemoveHeader(lsMessage) == 0)
     {
-      interface = iter->second.GetLocal(); // find the incoming interface
-      break;
+      // Truncated, trailing garbage or an unknown type: nothing after it
+      // can be framed, so the rest of the packet is dropped.
+      ERROR_LOG("Malformed LS message from " << sender << ", dropping " << packet->GetSize() << " bytes");
+      m_malformedPackets++;
+      m_malformedBytes += packet->GetSize();
+      return;
     }
-    idx++;
-  }
 
-  switch (lsMessage.GetMessageType())
-  {
-  case LSMessage::PING_REQ:
-    ProcessPingReq(lsMessage);
-    break;
-  case LSMessage::PING_RSP:
-    ProcessPingRsp(lsMessage);
-    break;
-  case LSMessage::HELLO_REQ:
-    ProcessHelloReq(lsMessage);
-    break;
-  case LSMessage::HELLO_RSP:
-    ProcessHelloRsp(lsMessage, interface);
-    break;
-  case LSMessage::LSA_m:
-   ProcessLsp(lsMessage, interface);
-   break;  
-  default:
-    ERROR_LOG("Unknown Message Type!");
-    break;
-  }
+    switch (lsMessage.GetMessageType())
+    {
+    case LSMessage::PING_REQ:
+      ProcessPingReq(lsMessage);
+      break;
+    case LSMessage::PING_RSP:
+      ProcessPingRsp(lsMessage);
+      break;
+    case LSMessage::HELLO_REQ:
+      ProcessHelloReq(lsMessage);
+      break;
+    case LSMessage::HELLO_RSP:
+      ProcessHelloRsp(lsMessage, interface, sender);
+      break;
+    case LSMessage::LSA_m:
+    case LSMessage::LSA_DELTA:
+    {
+      std::vector<Ptr<Packet>> flood;
+      bool changed = ProcessLsp(lsMessage, interface, sender, flood);
+      FloodLsas(flood, interface, GetArea(interface));
+      if (changed)
+      {
+        ScheduleSpf();
+      }
+      break;
+    }
+    case LSMessage::LS_UPDATE:
+      ProcessLsUpdate(lsMessage, packet, interface, sender);
+      break;
+    case LSMessage::LSA_ACK:
+      ProcessLsaAck(lsMessage, sender);
+      break;
+    case LSMessage::DB_DESC:
+      ProcessDbDesc(lsMessage, sender);
+      break;
+    case LSMessage::LSA_REQ:
+      ProcessLsaReq(lsMessage, sender);
+      break;
+    case LSMessage::BFD_HELLO:
+      ProcessBfdHello(sender);
+      break;
+    case LSMessage::GRACE:
+      ProcessGrace(lsMessage, sender);
+      break;
+    default:
+      ERROR_LOG("Unknown Message Type!");
+      m_malformedPackets++;
+      m_malformedBytes += packet->GetSize();
+      return;
+    }
+  } while (packet->GetSize() > 0);
 }
 
-void LSRoutingProtocol::ProcessPingReq(LSMessage lsMessage)
+void LSRoutingProtocol::ProcessPingReq(const LSMessage &lsMessage)
 {
   // Check destination address
   if (IsOwnAddress(lsMessage.GetPingReq().destinationAddress))
@@ -479,7 +858,7 @@ void LSRoutingProtocol::ProcessPingReq(LSMessage lsMessage)
   }
 }
 
-void LSRoutingProtocol::ProcessHelloReq(LSMessage lsMessage){  
+void LSRoutingProtocol::ProcessHelloReq(const LSMessage &lsMessage){  
   //Send Hello Reply Response
  // PRINT_LOG("enters HelloReq");
   std::string helloMessage = "HELLO_REPLY";
@@ -495,7 +874,7 @@ void LSRoutingProtocol::ProcessHelloReq(LSMessage lsMessage){
 }
 
 
-void LSRoutingProtocol::ProcessPingRsp(LSMessage lsMessage)
+void LSRoutingProtocol::ProcessPingRsp(const LSMessage &lsMessage)
 {
   // Check destination address
   
@@ -510,6 +889,7 @@ void LSRoutingProtocol::ProcessPingRsp(LSMessage lsMessage)
       TRAFFIC_LOG("Received PING_RSP, From Node: " << fromNode
                                                    << ", Message: " << lsMessage.GetPingRsp().pingMessage);
       m_pingTracker.erase(iter);
+      CancelTimer(PING_TIMER, lsMessage.GetSequenceNumber());
     }
     else
     {
@@ -518,387 +898,1890 @@ void LSRoutingProtocol::ProcessPingRsp(LSMessage lsMessage)
   }
 }
 
-void LSRoutingProtocol::ProcessHelloRsp(LSMessage lsMessage, Ipv4Address interfaceAd){
+void LSRoutingProtocol::ProcessHelloRsp(const LSMessage &lsMessage, Ipv4Address interfaceAd, Ipv4Address senderAd){
    // Check destination address
-   //PRINT_LOG("enters HelloRSP"); 
-   
-  if (IsOwnAddress(lsMessage.GetHelloRsp().destinationAddress)){
-  //process the message
-  //address of the node whose neighbours are being discovered
-   Ipv4Address m_node = lsMessage.GetHelloRsp().destinationAddress;  
-   uint32_t current_node;
-   std::istringstream sin(ReverseLookup(m_node));
-   sin >> current_node;
-  // PRINT_LOG("LINE 528");
-  // PRINT_LOG(current_node);
-  // PRINT_LOG(ReverseLookup(m_mainAddress));
-  // m_current_node = current_node;
-
-   //address of the neighbour node of m_node above
-   Ipv4Address neighbor_discovered = lsMessage.GetOriginatorAddress();
-   std::string neighbourNumStr = ReverseLookup(lsMessage.GetOriginatorAddress());
-   uint32_t neighborNum;
-   std::istringstream s(neighbourNumStr);
-   s >> neighborNum;
-   NeighborTableEntry neighbourEntry;
-   //neighbourEntry.nodeNumber = neighborNum;
-   neighbourEntry.neighborAddr = neighbor_discovered;
-   neighbourEntry.t_stamp = Simulator::Now();
-   neighbourEntry.interfaceAddr = interfaceAd;
-
-   //PRINT_LOG(neighbourEntry.neighborAddr);
-   //PRINT_LOG(neighbourEntry.t_stamp);
-   //PRINT_LOG(neighbourEntry.interfaceAddr);
-
-   std::map<uint32_t, NeighborTableEntry>::iterator iter;
-   iter = m_neighbors.find(neighborNum);
-   if (iter == m_neighbors.end())
-   //the current node is not found in the map and is added
-    {  
-      m_neighbors.insert({neighborNum, neighbourEntry});
-    }
-   else
-    {
-        iter->second = neighbourEntry;             
-    }
-  }
-  //LSAdvertise();
- // PRINT_LOG(m_current_node);
- // PRINT_LOG(m_neighbors.size());
- // PRINT_LOG("leaves HelloRSP"); 
-  
+  if (!IsOwnAddress(lsMessage.GetHelloRsp().destinationAddress))
+  {
+    return;
+  }
+
+  //address of the neighbour node of m_node above
+  Ipv4Address neighbor_discovered = lsMessage.GetOriginatorAddress();
+  uint32_t neighborNum;
+  if (!LookupNode(neighbor_discovered, neighborNum))
+  {
+    return;
+  }
+
+  bool adjacencyChanged = false;
+  bool isNew = false;
+  std::map<uint32_t, NeighborTableEntry>::iterator iter;
+  iter = m_neighbors.find(neighborNum);
+  if (iter == m_neighbors.end())
+  //the current node is not found in the map and is added
+  {
+    NeighborTableEntry neighbourEntry;
+    neighbourEntry.srtt = Seconds(0);
+    neighbourEntry.linkwt = 1;
+    neighbourEntry.advertisedCost = 1;
+    neighbourEntry.graceUntil = Seconds(0);
+    neighbourEntry.dbDescSent = false;
+    neighbourEntry.dbDescHeard = false;
+    iter = m_neighbors.insert({neighborNum, neighbourEntry}).first;
+    adjacencyChanged = true;
+    isNew = true;
+  }
+  NeighborTableEntry &entry = iter->second;
+  entry.neighborAddr = neighbor_discovered;
+  entry.t_stamp = Simulator::Now();
+  entry.interfaceAddr = interfaceAd;
+  entry.linkAddr = senderAd;
+  entry.area = GetArea(interfaceAd);
+  // The next reply is due one HELLO period (5 s) from now; as with the old
+  // audit, the neighbor is dropped when that reply is missed.
+  ArmTimer(NEIGHBOR_TIMER, neighborNum, m_neighborTimeout + Seconds(5));
+
+  // The reply echoes the sequence number of our HELLO, which dates it.
+  std::map<uint32_t, Time>::iterator sent = m_helloSentTime.find(lsMessage.GetSequenceNumber());
+  if (sent != m_helloSentTime.end() && UpdateLinkCost(entry, Simulator::Now() - sent->second))
+  {
+    adjacencyChanged = true;
+  }
+  if (adjacencyChanged)
+  {
+    TriggerLsAdvertise();
+  }
+  if (!isNew && !entry.dbDescSent && entry.graceUntil > Simulator::Now())
+  {
+    // A neighbor that announced a restart is answering again: resync it.
+    SendDbDesc(entry);
+  }
+  if (isNew)
+  {
+    // New adjacency: swap LSDB summaries instead of waiting for refreshes.
+    SendDbDesc(entry);
+    if (m_restarting)
+    {
+      bool allBack = true;
+      for (unsigned int i = 0; i < m_graceNeighbors.size(); i++)
+      {
+        allBack = allBack && m_neighbors.find(m_graceNeighbors[i]) != m_neighbors.end();
+      }
+      if (allBack)
+      {
+        ExitGracefulRestart();
+      }
+    }
+  }
 }
 
-void LSRoutingProtocol::AuditNeighbors()
+bool LSRoutingProtocol::UpdateLinkCost(NeighborTableEntry &entry, Time rtt)
 {
- // PRINT_LOG("enteryingAuditNeighbors");
-  m_neighborTimeout = Seconds(5.0);
-  std::map<uint32_t, NeighborTableEntry>::iterator iter; 
-
-  for (iter = m_neighbors.begin(); iter != m_neighbors.end();)
+  // Smoothed RTT as in TCP: srtt += alpha * (sample - srtt)
+  double sample = rtt.GetNanoSeconds();
+  double srtt = entry.srtt.IsZero() ? sample : entry.srtt.GetNanoSeconds() + m_rttAlpha * (sample - entry.srtt.GetNanoSeconds());
+  entry.srtt = NanoSeconds((uint64_t)srtt);
+
+  double unit = std::max<int64_t>(m_linkCostUnit.GetNanoSeconds(), 1);
+  entry.linkwt = std::max<uint32_t>(1, (uint32_t)std::ceil(srtt / unit));
+
+  // Only move the advertised cost when the measurement has drifted by more
+  // than the hysteresis band, so that jitter does not turn into LSAs.
+  double drift = std::fabs((double)entry.linkwt - (double)entry.advertisedCost);
+  if (drift > m_linkCostHysteresis * entry.advertisedCost)
   {
-    NeighborTableEntry neighbor_entry = iter->second;
-    
-        if (neighbor_entry.t_stamp.GetMilliSeconds() + m_neighborTimeout.GetMilliSeconds() <= Simulator::Now().GetMilliSeconds())
-        //if (neighbor_entries[i].t_stamp.GetMilliSeconds() + 10000 <= Simulator::Now().GetMilliSeconds())
-        {
-            m_neighbors.erase(iter++);           
-        }
-        else
-        {
-          ++iter; 
-        }     
+    entry.advertisedCost = entry.linkwt;
+    return true;
   }
-  //LSAdvertise();
+  return false;
+}
+
+void LSRoutingProtocol::AuditNeighbors()
+{
+  // Expiry of neighbors, pings and LSAs runs off the timer wheel; this
+  // periodic task only sends the HELLO.
   BroadcastHello();
-  // Rechedule timer //TODO--look into m_auditPingsTimer
- LSAdvertise();
+  SampleControlRate();
   m_auditNeighborsTimer.Schedule(Seconds(5));
-   //PRINT_LOG("LeavingAuditNeighbors");
 }
 
-void LSRoutingProtocol::BroadcastHello()
+uint64_t LSRoutingProtocol::GetWheelTick() const
 {
-  //PRINT_LOG("enters BroadcastHello");
-  std::string helloMessage = "HELLO";
-  int m_maxTTL = 1;
-  uint32_t sequenceNumber = GetNextSequenceNumber();
-  Ptr<Packet> pkt = Create<Packet>();
-  LSMessage lsMessage = LSMessage(LSMessage::HELLO_REQ, sequenceNumber, m_maxTTL, m_mainAddress);
-  lsMessage.SetHelloReq(Ipv4Address::GetAny(), helloMessage);
-  pkt->AddHeader(lsMessage);
-  BroadcastPacket(pkt);
-  
-  //PRINT_LOG("finished BroadcastHello");
-  // Rechedule timer
-  //m_Hello_Timer.Schedule(MilliSeconds(10000));
+  return Simulator::Now().GetNanoSeconds() / m_wheelTick.GetNanoSeconds();
 }
 
-
-void LSRoutingProtocol::LSAdvertise()
+void LSRoutingProtocol::ArmTimer(TimerKind kind, uint32_t id, Time delay)
 {
-  //PRINT_LOG("enters LSAdvertise");
-  uint32_t sequenceNumber = GetNextSequenceNumber();
- 
-  neighborInfo n_nodes;
-  uint32_t linkcost = 1;
-  int m_maxTTL = 1;
- // PRINT_LOG(m_current_node);
-  //PRINT_LOG(m_neighbors.size());
-  for (auto itr = m_neighbors.begin(); itr != m_neighbors.end(); itr++){  
-    uint32_t node_num = itr->first;
-    //PRINT_LOG(node_num);
-    n_nodes.push_back(std::make_pair(node_num, linkcost));   
+  if (m_timerWheel.GetNScheduled() == 0)
+  {
+    // Idle wheel: catch up with the clock so the deadline is filed relative to now.
+    std::vector<uint64_t> none;
+    m_timerWheel.Advance(GetWheelTick(), none);
+  }
+  // Round up, so nothing expires early.
+  uint64_t ticks = (delay.GetNanoSeconds() + m_wheelTick.GetNanoSeconds() - 1) / m_wheelTick.GetNanoSeconds();
+  uint64_t deadline = GetWheelTick() + ticks;
+  m_timerWheel.Schedule(((uint64_t)kind << 32) | id, deadline);
+  if (!m_wheelTimer.IsRunning() ||
+      Simulator::Now() + m_wheelTimer.GetDelayLeft() > NanoSeconds(deadline * m_wheelTick.GetNanoSeconds()))
+  {
+    ScheduleWheel();
   }
- /* PRINT_LOG(n_nodes.size());
-   PRINT_LOG(n_nodes[0].first);
-   PRINT_LOG(n_nodes[0].second);
-     PRINT_LOG(n_nodes[1].first);
-   PRINT_LOG(n_nodes[1].second);
-  PRINT_LOG("line 613");*/
-
-  Ptr<Packet> pkt = Create<Packet>();
-  LSMessage lsMessage = LSMessage(LSMessage::LSA_m, sequenceNumber, m_maxTTL, m_mainAddress);
-  lsMessage.SetLsA(n_nodes);
- 
-  pkt->AddHeader(lsMessage); 
-  BroadcastPacket(pkt);
- 
-  /*neighborInfo neighborinfoEntry = lsMessage.GetLsA().lsaMessage;
-  for (unsigned int i=0; i< neighborinfoEntry.size(); i++){
-    PRINT_LOG(neighborinfoEntry[i].first);
-    PRINT_LOG(neighborinfoEntry[i].second);
-  }*/
-  
 }
 
-
-void LSRoutingProtocol::ProcessLsp(LSMessage lsMessage, Ipv4Address interface_a)
+void LSRoutingProtocol::ScheduleWheel()
 {
-
-// node from which current node is receiving the LSP
-  //Ipv4Address fromNode = lsMessage.GetOriginatorAddress();
-  std::string fromNodeNumstr = ReverseLookup(lsMessage.GetOriginatorAddress());
-  uint32_t fromNodeNum;
-  std::istringstream sin(fromNodeNumstr);
-  sin >> fromNodeNum;
-  //PRINT_LOG(fromNodeNum);
-  /*
-  PRINT_LOG(m_current_node);
-  PRINT_LOG(fromNodeNum);
-  neighborInfo neighborinfoEntry = lsMessage.GetLsA().lsaMessage;
-  for (unsigned int i=0; i< neighborinfoEntry.size(); i++){
-    PRINT_LOG(neighborinfoEntry[i].first);
-    PRINT_LOG(neighborinfoEntry[i].second);}
-    */
-
-//sequence number of the message
-  uint32_t seqNum = lsMessage.GetSequenceNumber();
- // PRINT_LOG(seqNum);
-
-//check if LSP is from a new node that is not in the m_validLSP 
-  std::map<uint32_t, LSPneighbors>::iterator iter;
-  iter = m_validLSP.find(fromNodeNum);
-  if (iter == m_validLSP.end())
-  {// the LSP is from a new node and is not in the m_validLSP
-  LSPneighbors lspEntry;
-  lspEntry.seqNumber = seqNum;
-  lspEntry.interfaceAd = interface_a;
-  lspEntry.neighbornodeandCost = lsMessage.GetLsA().lsaMessage;  //check if this is working right
-  m_validLSP.insert({fromNodeNum, lspEntry});
+  // Sleep until the wheel has something to do rather than waking every
+  // tick.  The wheel may lag the clock by empty ticks, so its next slot
+  // can already be due.
+  m_wheelTimer.Cancel();
+  uint64_t next;
+  if (m_timerWheel.GetNextExpiry(next))
+  {
+    Time at = NanoSeconds(next * m_wheelTick.GetNanoSeconds());
+    m_wheelTimer.Schedule(std::max(at - Simulator::Now(), Seconds(0)));
   }
+}
 
-  else
-  {// check for the sequence number 
-  uint32_t storedSeqNum = iter->second.seqNumber;
-    if (storedSeqNum >= seqNum)
-     {return;
-     }   
-  //update the neighborinfo for a node who sent LSA
-  LSPneighbors lspEntry;
-  lspEntry.seqNumber = seqNum;
-  lspEntry.neighbornodeandCost = lsMessage.GetLsA().lsaMessage;
-  iter->second = lspEntry;  
-   }
-  //PRINT_LOG(m_validLSP.size());
-  /*
-  for (auto j= m_validLSP.begin(); j !=m_validLSP.end(); ++j){
-    PRINT_LOG(j->first);
-    LSPneighbors neighbornodeandCentry = j->second;
-     std::vector <std::pair<uint32_t, uint32_t>> neighbornodeandC = neighbornodeandCentry.neighbornodeandCost;
-    for (unsigned int u = 0; u<neighbornodeandC.size(); u++){
-      PRINT_LOG("nodenumber:");
-      PRINT_LOG(neighbornodeandC[u].first);
-      PRINT_LOG("cost:");
-      PRINT_LOG(neighbornodeandC[u].second);
-    }
-   // PRINT_LOG(j->second.neighbornodeandCost.first);
-    //PRINT_LOG(j->second.neighbornodeandCost.second);
-    //PRINT_LOG(m_validLSP[j].second.first);
-  }*/
-
-  Dijkstra();
-
-  //flood the message
-  Ptr<Packet> pkt = Create<Packet>();
-  lsMessage.SetTTL(lsMessage.GetTTL() - 1);
-  pkt->AddHeader(lsMessage);
-  //floodLSA(pkt, interface_a);
-  BroadcastPacket(pkt);
-  //PRINT_LOG("leaves ProcessLsp");  
+void LSRoutingProtocol::CancelTimer(TimerKind kind, uint32_t id)
+{
+  m_timerWheel.Cancel(((uint64_t)kind << 32) | id);
 }
 
-void LSRoutingProtocol::floodLSA(Ptr<Packet> packet, Ipv4Address fromNode)
+void LSRoutingProtocol::RunTimers()
 {
- for (std::map<Ptr<Socket>, Ipv4InterfaceAddress>::const_iterator i = m_socketAddresses.begin();
-       i != m_socketAddresses.end(); i++)
+  std::vector<uint64_t> expired;
+  m_timerWheel.Advance(GetWheelTick(), expired);
+
+  bool adjacencyChanged = false;
+  bool lsdbChanged = false;
+  bool routesRepaired = false;
+  for (unsigned int i = 0; i < expired.size(); i++)
   {
-    Ptr<Packet> pkt = packet->Copy();
-    Ipv4Address broadcastAddr = i->second.GetLocal().GetSubnetDirectedBroadcast(i->second.GetMask());
-    if (broadcastAddr != fromNode){
-    i->first->SendTo(pkt, 0, InetSocketAddress(broadcastAddr, LS_PORT_NUMBER));
+    uint32_t id = (uint32_t)expired[i];
+    switch ((TimerKind)(expired[i] >> 32))
+    {
+    case NEIGHBOR_TIMER:
+    case BFD_TIMER:
+    {
+      // No HELLO reply for NeighborTimeout, or no fast hello for
+      // BfdDetectMultiplier intervals.
+      std::map<uint32_t, NeighborTableEntry>::iterator neighbor = m_neighbors.find(id);
+      if (neighbor != m_neighbors.end() && neighbor->second.graceUntil > Simulator::Now())
+      {
+        // Restarting: keep forwarding through it until the grace period is over.
+        ArmTimer((TimerKind)(expired[i] >> 32), id, neighbor->second.graceUntil - Simulator::Now());
+      }
+      else if (neighbor != m_neighbors.end())
+      {
+        RemoveNeighbor(id);
+        routesRepaired |= RepairRoutes(id);
+        adjacencyChanged = true;
+      }
+      break;
     }
-  }
-}
-
-void LSRoutingProtocol::Dijkstra()
-{ 
-  //clear routing table first
-  m_routingTable.clear();
-  //initialize the confirmed list with an entry for myself with a cost of 0
-  std::vector<std::pair<uint32_t, std::pair<uint32_t, uint32_t>>> confirmed;  //destnode, cost, next hop
-  std::vector<std::pair<uint32_t, std::pair<uint32_t, uint32_t>>> tentative;
-
-  std::string nodetoaddstr = ReverseLookup(m_mainAddress);
-  uint32_t nodetoadd;
-  std::istringstream sin(nodetoaddstr);
-  sin >> nodetoadd;
-
-  //uint32_t nodetoadd = m_mainAddress;
-  uint32_t cost_to_node = 0;
-  confirmed.push_back(make_pair(nodetoadd, std::make_pair(cost_to_node, nodetoadd)));
-  uint32_t prev_cost = cost_to_node;
-  if (m_neighbors.size() ==0){
-    return;
-  }
-  while (1){
-  uint32_t nextNode = nodetoadd;   
-  uint32_t viaNode;
-  std::map<uint32_t, LSPneighbors>::iterator iter;
-  iter = m_validLSP.find(nextNode);
-  //bool contExec = true;
-  if (iter == m_validLSP.end())
- { return;}
-    LSPneighbors neighborInfoent = iter->second;
-    std::vector <std::pair<uint32_t, uint32_t>> neighborInfoentry = neighborInfoent.neighbornodeandCost;
- 
-    for (unsigned int i =0; i < neighborInfoentry.size(); i++){
-      uint32_t node_num = neighborInfoentry[i].first;
-      uint32_t cost = neighborInfoentry[i].second;
-      uint32_t new_cost = cost + prev_cost;
-      std::pair<uint32_t, std::pair<uint32_t, uint32_t>> p;
-      if (prev_cost == 0){
-         p =std::make_pair(node_num, std::make_pair(new_cost, node_num));
+    case PING_TIMER:
+    {
+      std::map<uint32_t, Ptr<PingRequest>>::iterator iter = m_pingTracker.find(id);
+      if (iter != m_pingTracker.end())
+      {
+        DEBUG_LOG("Ping expired. Message: " << iter->second->GetPingMessage()
+                                            << " Timestamp: " << iter->second->GetTimestamp().GetMilliSeconds()
+                                            << " CurrentTime: " << Simulator::Now().GetMilliSeconds());
+        m_pingTracker.erase(iter);
       }
-      else
-      {p =std::make_pair(node_num, std::make_pair(new_cost, viaNode));}
-
-      //check if p is not in the confirmed or tentative list
-      bool notinConfirmed = true;
-      for (unsigned int k = 0; k <confirmed.size(); k++)
-      { if (confirmed[k].first == node_num){
-        notinConfirmed = false;
+      break;
+    }
+    case LSA_AGE_TIMER:
+    {
+      // An originator refreshes its LSA every LsaRefreshInterval; one we have
+      // not heard from for LsaMaxAge is gone, so withdraw its links.  A border
+      // router has an LSA in each of its areas and they share the timer,
+      // which was last armed for the newest one.
+      Time now = Simulator::Now();
+      Time newest = Seconds(0);
+      for (std::map<uint32_t, AreaState>::iterator area = m_areas.begin(); area != m_areas.end(); area++)
+      {
+        std::map<uint32_t, LSPneighbors>::iterator iter = area->second.lsdb.find(id);
+        if (iter == area->second.lsdb.end())
+        {
+          continue;
         }
+        if (iter->second.installTime + m_lsaMaxAge > now)
+        {
+          newest = Max(newest, iter->second.installTime);
+          continue;
+        }
+        lsdbChanged |= area->second.spf.UpdateAdjacency(id, neighborInfo());
+        area->second.seenSeq.erase(iter->second.originator.Get());
+        area->second.lsdb.erase(iter);
       }
-      if (notinConfirmed) {     
-          unsigned int count  = 0;
-          for (unsigned int j =0; j < tentative.size(); j++){                        
-            uint32_t node_tentative = tentative[j].first;
-            uint32_t storedcost = tentative[j].second.first;
-            if (node_tentative == node_num)
-            {
-              count = count+1;
-              if (storedcost > new_cost){
-                tentative[j] = p;
-              }                
-            }
-          }
-          if (count == 0)
-          {
-            tentative.push_back(p);
-          }      
+      if (newest.IsStrictlyPositive())
+      {
+        ArmTimer(LSA_AGE_TIMER, id, newest + m_lsaMaxAge - now);
       }
+      break;
+    }
     }
-  
-  //find the entry from the Tentative list with the lowest cost and move it to the Confirmed List
-  //set that node as next node and update cost_to_node
-  if (tentative.empty()){break;}
-  uint32_t min_cost;
-  unsigned int index = 0;
-  min_cost = tentative[index].second.first;
-  for (unsigned int i =1; i < tentative.size(); i++){
-    if (tentative[i].second.first < min_cost){
-      index = i;
-      min_cost = tentative[index].second.first;
-    }   
-  }
-  std::pair<uint32_t, std::pair<uint32_t, uint32_t>> toConfirmed = tentative[index];
-  confirmed.push_back(toConfirmed);
-  tentative.erase(tentative.begin() + index);
-  //nextNode = toConfirmed.first;
-  nodetoadd = toConfirmed.first;
-  viaNode = toConfirmed.second.second;
-  prev_cost = toConfirmed.second.first;
-  
-  
-
-//iterate through each entry in the confirmed and add it to m_routingTable
-//dest node no, dest addr, next hop number,  next hop Addr, next hop interface addr, cost
-
-  for (unsigned int i =1; i < confirmed.size(); i++){
-    uint32_t dest_node = confirmed[i].first;  
-    Ipv4Address dest_addr = ResolveNodeIpAddress(dest_node);
-    uint32_t next_hop = confirmed[i].second.second;
-    Ipv4Address next_hopAddr = ResolveNodeIpAddress(next_hop);
-    uint32_t cost = confirmed[i].second.first;
-    // get next_hop Ipv4 address and interface Addr
-    std::map<uint32_t, NeighborTableEntry>::iterator it;   
-    it = m_neighbors.find(next_hop);
-    /*
-    if (it == m_neighbors.end()){
-      PRINT_LOG("CANNOT FIND ON 821");
-    }*/
-    //PRINT_LOG("line 823");
-    //PRINT_LOG(m_current_node);
-   // PRINT_LOG(next_hop);
-    Ipv4Address interAddr =  it->second.interfaceAddr;
-   // PRINT_LOG(interAddr);
-    RoutingTableEntry r = {dest_addr, next_hop, next_hopAddr, interAddr, cost};
-    m_routingTable.insert({dest_node, r});
   }
+  if (routesRepaired)
+  {
+    InstallRoutes();
+    RebuildFib();
   }
-   
+  if (lsdbChanged)
+  {
+    ScheduleSpf();
+  }
+  // Only a change in our adjacency is news; the refresh timer covers the rest.
+  if (adjacencyChanged)
+  {
+    TriggerLsAdvertise();
+  }
+  ScheduleWheel();
 }
 
-
-bool LSRoutingProtocol::IsOwnAddress(Ipv4Address originatorAddress)
+void LSRoutingProtocol::RemoveNeighbor(uint32_t neighborNum)
 {
-  // Check all interfaces
+  CancelTimer(NEIGHBOR_TIMER, neighborNum);
+  CancelTimer(BFD_TIMER, neighborNum);
+  m_neighbors.erase(neighborNum);
+}
+
+bool LSRoutingProtocol::RepairRoutes(uint32_t neighborNum)
+{
+  bool changed = false;
+  for (std::map<uint32_t, RoutingTableEntry>::iterator iter = m_routingTable.begin(); iter != m_routingTable.end();)
+  {
+    RoutingTableEntry &r = iter->second;
+    if (r.backup.nodeNum == neighborNum)
+    {
+      r.backup.nodeNum = LS_NO_NODE;
+      changed = true;
+    }
+    unsigned int before = r.nextHops.size();
+    for (unsigned int i = 0; i < r.nextHops.size();)
+    {
+      if (r.nextHops[i].nodeNum == neighborNum)
+      {
+        r.nextHops.erase(r.nextHops.begin() + i);
+      }
+      else
+      {
+        i++;
+      }
+    }
+    if (r.nextHops.size() == before)
+    {
+      iter++;
+      continue;
+    }
+    changed = true;
+    if (r.nextHops.empty())
+    {
+      if (r.backup.nodeNum == LS_NO_NODE)
+      {
+        m_routingTable.erase(iter++);
+        continue;
+      }
+      // The alternate does not route back through us, so it is safe to use
+      // before anyone else has heard of the failure.
+      r.nextHops.push_back(r.backup);
+      r.cost = r.backupCost;
+      r.backup.nodeNum = LS_NO_NODE;
+    }
+    r.nextHopNum = r.nextHops[0].nodeNum;
+    r.nextHopAddr = r.nextHops[0].addr;
+    r.interfaceAddr = r.nextHops[0].interfaceAddr;
+    iter++;
+  }
+  return changed;
+}
+
+void LSRoutingProtocol::BfdTick()
+{
+  // Silence is detected by the BFD_TIMER armed in ProcessBfdHello.
+  for (std::map<uint32_t, NeighborTableEntry>::iterator iter = m_neighbors.begin(); iter != m_neighbors.end(); iter++)
+  {
+    // Header only; nothing looks at the sequence number, so none is spent on it.
+    LSMessage lsMessage = LSMessage(LSMessage::BFD_HELLO, 0, 1, m_mainAddress);
+    Ptr<Packet> packet = Create<Packet>();
+    packet->AddHeader(lsMessage);
+    SendToNeighbor(iter->second, packet);
+  }
+  m_bfdTimer.Schedule(m_bfdInterval);
+}
+
+void LSRoutingProtocol::ProcessBfdHello(Ipv4Address sender)
+{
+  // The session comes up with the first fast hello from a known neighbor;
+  // until then the neighbor is only watched by the HELLO audit, so a peer
+  // without fast hellos is never torn down by them.  The extra tick covers
+  // the phase between our timer and the peer's.
+  std::map<uint32_t, NeighborTableEntry>::iterator from = FindNeighbor(sender);
+  if (from == m_neighbors.end())
+  {
+    return;
+  }
+  ArmTimer(BFD_TIMER, from->first, NanoSeconds(m_bfdInterval.GetNanoSeconds() * (m_bfdMultiplier + 1)));
+}
+
+void LSRoutingProtocol::TriggerLsAdvertise()
+{
+  if (m_lsaOriginateTimer.IsRunning())
+  {
+    // An origination is already pending and will carry this change too.
+    return;
+  }
+  Time earliest = m_lastLsaOriginated + m_lsaMinInterval;
+  if (m_lastLsaOriginated.IsZero() || earliest <= Simulator::Now())
+  {
+    LSAdvertise();
+  }
+  else
+  {
+    m_lsaOriginateTimer.Schedule(earliest - Simulator::Now());
+  }
+}
+
+void LSRoutingProtocol::SampleControlRate()
+{
+  Time elapsed = Simulator::Now() - m_controlRateSampleTime;
+  if (elapsed.IsStrictlyPositive())
+  {
+    m_controlBytesPerSecond = (m_controlTxBytes - m_controlRateSampleBytes) / elapsed.GetSeconds();
+  }
+  m_controlRateSampleTime = Simulator::Now();
+  m_controlRateSampleBytes = m_controlTxBytes;
+}
+
+uint64_t
+LSRoutingProtocol::GetControlBytesSent() const
+{
+  return m_controlTxBytes;
+}
+
+double
+LSRoutingProtocol::GetControlBytesPerSecond() const
+{
+  return m_controlBytesPerSecond;
+}
+
+void LSRoutingProtocol::BroadcastHello()
+{
+  //PRINT_LOG("enters BroadcastHello");
+  std::string helloMessage = "HELLO";
+  int m_maxTTL = 1;
+  uint32_t sequenceNumber = GetNextSequenceNumber();
+
+  // Remember when each HELLO left so that replies give an RTT sample; replies
+  // older than the neighbor timeout are of no use.
+  Time now = Simulator::Now();
+  for (std::map<uint32_t, Time>::iterator iter = m_helloSentTime.begin(); iter != m_helloSentTime.end();)
+  {
+    if (iter->second + m_neighborTimeout < now)
+    {
+      m_helloSentTime.erase(iter++);
+    }
+    else
+    {
+      ++iter;
+    }
+  }
+  m_helloSentTime[sequenceNumber] = now;
+
+  Ptr<Packet> pkt = Create<Packet>();
+  LSMessage lsMessage = LSMessage(LSMessage::HELLO_REQ, sequenceNumber, m_maxTTL, m_mainAddress);
+  lsMessage.SetHelloReq(Ipv4Address::GetAny(), helloMessage);
+  pkt->AddHeader(lsMessage);
+  BroadcastPacket(pkt);
+  
+  //PRINT_LOG("finished BroadcastHello");
+  // Rechedule timer
+  //m_Hello_Timer.Schedule(MilliSeconds(10000));
+}
+
+
+void LSRoutingProtocol::RefreshLsa()
+{
+  m_fullLsaDue = true;
+  LSAdvertise();
+}
+
+void LSRoutingProtocol::LSAdvertise()
+{
+  //PRINT_LOG("enters LSAdvertise");
+  if (m_restarting)
+  {
+    // Our adjacency is still incomplete; the neighbors keep advertising
+    // theirs to us until ExitGracefulRestart() originates ours.
+    return;
+  }
+  m_lastLsaOriginated = Simulator::Now();
+  m_lsaOriginateTimer.Cancel();
+  // Refresh our LSA before it can age out elsewhere, even if nothing changes.
+  m_lsaRefreshTimer.Cancel();
+  m_lsaRefreshTimer.Schedule(m_lsaRefreshInterval);
+
+  uint32_t selfNode = GetSelfNode();
+  bool fullLsa = m_fullLsaDue;
+  m_fullLsaDue = false;
+
+  // One LSA per area, listing only our neighbors in that area; a border
+  // router adds the destinations it reaches through its other areas.
+  for (std::map<uint32_t, AreaState>::iterator area = m_areas.begin(); area != m_areas.end(); area++)
+  {
+    neighborInfo n_nodes;
+    for (auto itr = m_neighbors.begin(); itr != m_neighbors.end(); itr++){
+      if (itr->second.area == area->first)
+      {
+        n_nodes.push_back(std::make_pair(itr->first, itr->second.advertisedCost));
+      }
+    }
+
+    // A change is usually cheaper to send as a delta against our previous
+    // LSA; the periodic refresh always carries the full list so that nodes
+    // which missed a delta catch up.  Deltas do not carry summaries, so a
+    // change in those always goes out in full.
+    uint32_t sequenceNumber = GetNextLsaSequenceNumber();
+    LSMessage lsMessage = LSMessage(LSMessage::LSA_m, sequenceNumber, m_maxTTL, m_mainAddress);
+    lsMessage.SetLsA(n_nodes, area->second.summaries);
+    std::map<uint32_t, LSPneighbors>::iterator previous = area->second.lsdb.find(selfNode);
+    if (!fullLsa && previous != area->second.lsdb.end() && previous->second.summaries == area->second.summaries)
+    {
+      LSMessage delta = BuildLsaDelta(previous->second, n_nodes, sequenceNumber);
+      if (delta.GetSerializedSize() < lsMessage.GetSerializedSize())
+      {
+        lsMessage = delta;
+      }
+    }
+    floodLSA(lsMessage, Ipv4Address::GetAny(), LS_NO_NODE, area->first);
+
+    // Keep our own LSA in the database as well, so SPF is rooted at the same
+    // adjacency the rest of the area sees for us.
+    LSPneighbors selfEntry;
+    selfEntry.interfaceAd = m_mainAddress;
+    selfEntry.originator = m_mainAddress;
+    selfEntry.seqNumber = sequenceNumber;
+    selfEntry.installTime = Simulator::Now();
+    selfEntry.neighbornodeandCost = n_nodes;
+    selfEntry.summaries = area->second.summaries;
+    LSPneighbors &stored = area->second.lsdb[selfNode];
+    stored = selfEntry;
+    if (area->second.spf.UpdateAdjacency(selfNode, GetSpfAdjacency(area->first, selfNode, stored)))
+    {
+      ScheduleSpf();
+    }
+  }
+ 
+  /*neighborInfo neighborinfoEntry = lsMessage.GetLsA().lsaMessage;
+  for (unsigned int i=0; i< neighborinfoEntry.size(); i++){
+    PRINT_LOG(neighborinfoEntry[i].first);
+    PRINT_LOG(neighborinfoEntry[i].second);
+  }*/
+  
+}
+
+
+bool LSRoutingProtocol::ProcessLsp(LSMessage &lsMessage, Ipv4Address interface_a, Ipv4Address sender,
+                                   std::vector<Ptr<Packet>> &flood)
+{
+  Ipv4Address originator = lsMessage.GetOriginatorAddress();
+  uint32_t seqNum = lsMessage.GetSequenceNumber();
+  m_lsaReceivedCount++;
+
+  // Every copy a neighbor sends us is acknowledged, duplicates included:
+  // the neighbor may be retransmitting because our last ack was lost.
+  uint32_t fromNeighbor = LS_NO_NODE;
+  std::map<uint32_t, NeighborTableEntry>::iterator from = FindNeighbor(sender);
+  if (from != m_neighbors.end())
+  {
+    fromNeighbor = from->first;
+    AcknowledgeLsa(from->second, originator.Get(), seqNum);
+  }
+
+  // Our own LSA coming back, or a copy we already have from another
+  // neighbor: drop it before doing any other work.
+  if (IsOwnAddress(originator))
+  {
+    return false;
+  }
+  // LSAs belong to the area of the interface they arrive on.
+  uint32_t areaId = GetArea(interface_a);
+  std::map<uint32_t, AreaState>::iterator areaIter = m_areas.find(areaId);
+  if (areaIter == m_areas.end())
+  {
+    return false;
+  }
+  AreaState &area = areaIter->second;
+  std::unordered_map<uint32_t, uint32_t>::iterator seen = area.seenSeq.find(originator.Get());
+  if (seen != area.seenSeq.end() && seen->second >= seqNum)
+  {
+    if (seen->second > seqNum && from != m_neighbors.end() && from->second.neighborAddr == originator)
+    {
+      // The neighbor's own LSA went backwards: it restarted without a
+      // snapshot, or from an old one.  Our summary shows it the sequence
+      // number to jump past, and everything else it lost.
+      from->second.dbDescHeard = false;
+      SendDbDesc(from->second);
+    }
+    return false;
+  }
+
+// node from which current node is receiving the LSP
+  uint32_t fromNodeNum;
+  if (!LookupNode(originator, fromNodeNum))
+  {
+    return false;
+  }
+
+  std::map<uint32_t, LSPneighbors>::iterator stored = area.lsdb.find(fromNodeNum);
+  if (lsMessage.GetMessageType() == LSMessage::LSA_DELTA
+      && (stored == area.lsdb.end() || stored->second.seqNumber != lsMessage.GetLsaDelta().baseSeq))
+  {
+    // A delta only makes sense on top of the exact LSA it was cut against.
+    // Without it, ask the neighbor for the full LSA and do not pass the
+    // delta on; the full LSA is flooded onwards once it arrives.
+    if (from != m_neighbors.end())
+    {
+      RequestLsa(from->second, originator, seqNum);
+    }
+    return false;
+  }
+  area.seenSeq[originator.Get()] = seqNum;
+
+  //flood the message on every interface of the area except the one it came in
+  //on.  This serializes it, so it must happen before the adjacency is moved out below.
+  //There is no hop limit: seenSeq stops the LSA at every node that already has
+  //it, so it reaches the whole area whatever its diameter.
+  flood.push_back(QueueLsaFlood(lsMessage, interface_a, fromNeighbor, areaId));
+
+  if (lsMessage.GetMessageType() == LSMessage::LSA_DELTA)
+  {
+    ApplyLsaDelta(stored->second.neighbornodeandCost, lsMessage.GetLsaDelta());
+  }
+  else
+  {
+    if (stored == area.lsdb.end())
+    {
+      stored = area.lsdb.insert(std::make_pair(fromNodeNum, LSPneighbors())).first;
+    }
+    stored->second.neighbornodeandCost = std::move(lsMessage.GetLsA().lsaMessage);
+    stored->second.summaries = std::move(lsMessage.GetLsA().summaries);
+  }
+  LSPneighbors &lspEntry = stored->second;
+  lspEntry.seqNumber = seqNum;
+  lspEntry.originator = originator;
+  lspEntry.installTime = Simulator::Now();
+  lspEntry.interfaceAd = interface_a;
+  ArmTimer(LSA_AGE_TIMER, fromNodeNum, m_lsaMaxAge);
+
+  // A refresh that advertises the same neighbors cannot move the tree.
+  return area.spf.UpdateAdjacency(fromNodeNum, GetSpfAdjacency(areaId, fromNodeNum, lspEntry));
+}
+
+void LSRoutingProtocol::ProcessLsUpdate(const LSMessage &lsMessage, Ptr<Packet> packet, Ipv4Address interface,
+                                        Ipv4Address sender)
+{
+  // Every LSA of the update goes into the LSDB before any is flooded on or
+  // SPF is scheduled, so the batch is one topology change and leaves again
+  // as one batch.
+  std::vector<Ptr<Packet>> flood;
+  bool changed = false;
+  for (uint32_t i = 0; i < lsMessage.GetLsUpdate().lsaCount && packet->GetSize() > 0; i++)
+  {
+    LSMessage lsa;
+    uint32_t remaining = packet->GetSize();
+    uint32_t size = packet->RemoveHeader(lsa);
+    if (size == 0 || size > remaining)
+    {
+      // The LSAs before this one were whole and stay processed; the rest of
+      // the packet cannot be framed and is dropped.
+      ERROR_LOG("Malformed LSA in LS_UPDATE from " << sender << ", dropping " << packet->GetSize() << " bytes");
+      m_malformedPackets++;
+      m_malformedBytes += packet->GetSize();
+      packet->RemoveAtEnd(packet->GetSize());
+      break;
+    }
+    if (lsa.GetMessageType() != LSMessage::LSA_m && lsa.GetMessageType() != LSMessage::LSA_DELTA)
+    {
+      ERROR_LOG("Unexpected message type in LS_UPDATE!");
+      continue;
+    }
+    changed |= ProcessLsp(lsa, interface, sender, flood);
+  }
+  FloodLsas(flood, interface, GetArea(interface));
+  if (changed)
+  {
+    ScheduleSpf();
+  }
+}
+
+LSMessage LSRoutingProtocol::BuildLsaDelta(const LSPneighbors &base, const neighborInfo &current, uint32_t sequenceNumber)
+{
+  // Both lists come out of std::maps keyed by node number, so they are
+  // sorted and one merge pass finds every difference.
+  neighborInfo changed;
+  std::vector<uint32_t> removed;
+  const neighborInfo &old = base.neighbornodeandCost;
+  unsigned int i = 0, j = 0;
+  while (i < old.size() || j < current.size())
+  {
+    if (j == current.size() || (i < old.size() && old[i].first < current[j].first))
+    {
+      removed.push_back(old[i++].first);
+    }
+    else if (i == old.size() || current[j].first < old[i].first)
+    {
+      changed.push_back(current[j++]);
+    }
+    else
+    {
+      if (old[i].second != current[j].second)
+      {
+        changed.push_back(current[j]);
+      }
+      i++;
+      j++;
+    }
+  }
+  LSMessage delta = LSMessage(LSMessage::LSA_DELTA, sequenceNumber, m_maxTTL, m_mainAddress);
+  delta.SetLsaDelta(base.seqNumber, changed, removed);
+  return delta;
+}
+
+void LSRoutingProtocol::ApplyLsaDelta(neighborInfo &adjacency, const LSMessage::LsaDelta &delta)
+{
+  for (unsigned int i = 0; i < delta.removed.size(); i++)
+  {
+    neighborInfo::iterator pos = std::lower_bound(adjacency.begin(), adjacency.end(),
+                                                  std::make_pair(delta.removed[i], (uint32_t)0));
+    if (pos != adjacency.end() && pos->first == delta.removed[i])
+    {
+      adjacency.erase(pos);
+    }
+  }
+  for (unsigned int i = 0; i < delta.changed.size(); i++)
+  {
+    neighborInfo::iterator pos = std::lower_bound(adjacency.begin(), adjacency.end(),
+                                                  std::make_pair(delta.changed[i].first, (uint32_t)0));
+    if (pos != adjacency.end() && pos->first == delta.changed[i].first)
+    {
+      pos->second = delta.changed[i].second;
+    }
+    else
+    {
+      adjacency.insert(pos, delta.changed[i]);
+    }
+  }
+}
+
+void LSRoutingProtocol::RequestLsa(const NeighborTableEntry &neighbor, Ipv4Address originator, uint32_t seqNum)
+{
+  LSMessage request = LSMessage(LSMessage::LSA_REQ, GetNextSequenceNumber(), 1, m_mainAddress);
+  request.SetLsaReq(LSMessage::lsaKeys(1, std::make_pair(originator.Get(), seqNum)));
+  Ptr<Packet> packet = Create<Packet>();
+  packet->AddHeader(request);
+  SendToNeighbor(neighbor, packet);
+}
+
+void LSRoutingProtocol::floodLSA(const LSMessage &lsMessage, Ipv4Address ingress, uint32_t fromNeighbor,
+                                 uint32_t area)
+{
+  SendOnInterfaces(QueueLsaFlood(lsMessage, ingress, fromNeighbor, area), ingress, area);
+}
+
+Ptr<Packet> LSRoutingProtocol::QueueLsaFlood(const LSMessage &lsMessage, Ipv4Address ingress, uint32_t fromNeighbor,
+                                            uint32_t area)
+{
+  Ptr<Packet> packet = Create<Packet>();
+  packet->AddHeader(lsMessage);
+
+  // Every neighbor behind an interface we flood on owes us an ack; until it
+  // arrives the LSA stays on that neighbor's retransmission list.  The
+  // neighbor we got it from already has it, and other areas never see it.
+  Ptr<Packet> stored = packet->Copy();
+  uint32_t originator = lsMessage.GetOriginatorAddress().Get();
+  uint32_t fanout = 0;
+  for (std::map<uint32_t, NeighborTableEntry>::iterator iter = m_neighbors.begin(); iter != m_neighbors.end(); iter++)
+  {
+    if (iter->first == fromNeighbor || iter->second.interfaceAddr == ingress || iter->second.area != area)
+    {
+      continue;
+    }
+    RetransmitEntry entry = {lsMessage.GetSequenceNumber(), stored, Simulator::Now()};
+    iter->second.retransmit[originator] = entry;
+    fanout++;
+  }
+  if (fanout > 0 && !m_retransmitTimer.IsRunning())
+  {
+    m_retransmitTimer.Schedule(m_lsaRetransmitInterval);
+  }
+  m_floodCount++;
+  m_floodFanout += fanout;
+  m_floodTrace(lsMessage.GetOriginatorAddress(), fanout);
+  return packet;
+}
+
+void LSRoutingProtocol::FloodLsas(const std::vector<Ptr<Packet>> &lsas, Ipv4Address ingress, uint32_t area)
+{
+  std::vector<Ptr<Packet>> packets = PackLsUpdates(lsas, GetAreaMaxPayload(area));
+  for (unsigned int i = 0; i < packets.size(); i++)
+  {
+    SendOnInterfaces(packets[i], ingress, area);
+  }
+}
+
+std::vector<Ptr<Packet>> LSRoutingProtocol::PackLsUpdates(const std::vector<Ptr<Packet>> &lsas, uint32_t maxPayload)
+{
+  LSMessage empty = LSMessage(LSMessage::LS_UPDATE, 0, 1, m_mainAddress);
+  empty.SetLsUpdate(0);
+  uint32_t headerSize = empty.GetSerializedSize();
+
+  std::vector<Ptr<Packet>> packets;
+  uint32_t first = 0;
+  while (first < lsas.size())
+  {
+    // As many LSAs as fit behind one LS_UPDATE header; an LSA too large for
+    // that still goes out, on its own.
+    uint32_t size = headerSize + lsas[first]->GetSize();
+    uint32_t last = first + 1;
+    while (last < lsas.size() && last - first < std::numeric_limits<uint16_t>::max() &&
+           size + lsas[last]->GetSize() <= maxPayload)
+    {
+      size += lsas[last++]->GetSize();
+    }
+    if (last - first == 1)
+    {
+      // No point wrapping a single LSA.
+      packets.push_back(lsas[first]);
+    }
+    else
+    {
+      Ptr<Packet> packet = Create<Packet>();
+      for (uint32_t i = first; i < last; i++)
+      {
+        packet->AddAtEnd(lsas[i]);
+      }
+      LSMessage update = LSMessage(LSMessage::LS_UPDATE, GetNextSequenceNumber(), 1, m_mainAddress);
+      update.SetLsUpdate(last - first);
+      packet->AddHeader(update);
+      packets.push_back(packet);
+    }
+    first = last;
+  }
+  return packets;
+}
+
+std::map<uint32_t, LSRoutingProtocol::NeighborTableEntry>::iterator
+LSRoutingProtocol::FindNeighbor(Ipv4Address address)
+{
+  uint32_t nodeNumber;
+  if (!LookupNode(address, nodeNumber))
+  {
+    return m_neighbors.end();
+  }
+  return m_neighbors.find(nodeNumber);
+}
+
+void LSRoutingProtocol::AcknowledgeLsa(NeighborTableEntry &neighbor, uint32_t originator, uint32_t seqNum)
+{
+  // The neighbor has this instance, so stop retransmitting it (or an older one).
+  std::map<uint32_t, RetransmitEntry>::iterator pending = neighbor.retransmit.find(originator);
+  if (pending != neighbor.retransmit.end() && pending->second.seqNumber <= seqNum)
+  {
+    neighbor.retransmit.erase(pending);
+  }
+  // Acks are held for LsaAckDelay so that several go out in one packet.
+  neighbor.pendingAcks.push_back(std::make_pair(originator, seqNum));
+  if (!m_ackTimer.IsRunning())
+  {
+    m_ackTimer.Schedule(m_lsaAckDelay);
+  }
+}
+
+void LSRoutingProtocol::FlushAcks()
+{
+  // Upper bound on acks per packet, to stay well inside an Ethernet MTU
+  const uint32_t maxAcksPerPacket = 128;
+  for (std::map<uint32_t, NeighborTableEntry>::iterator iter = m_neighbors.begin(); iter != m_neighbors.end(); iter++)
+  {
+    LSMessage::lsaKeys &pendingAcks = iter->second.pendingAcks;
+    for (uint32_t first = 0; first < pendingAcks.size(); first += maxAcksPerPacket)
+    {
+      uint32_t last = std::min<uint32_t>(first + maxAcksPerPacket, pendingAcks.size());
+      LSMessage lsMessage = LSMessage(LSMessage::LSA_ACK, GetNextSequenceNumber(), 1, m_mainAddress);
+      lsMessage.SetLsaAck(LSMessage::lsaKeys(pendingAcks.begin() + first, pendingAcks.begin() + last));
+      Ptr<Packet> packet = Create<Packet>();
+      packet->AddHeader(lsMessage);
+      SendToNeighbor(iter->second, packet);
+    }
+    pendingAcks.clear();
+  }
+}
+
+void LSRoutingProtocol::ProcessLsaAck(const LSMessage &lsMessage, Ipv4Address sender)
+{
+  std::map<uint32_t, NeighborTableEntry>::iterator from = FindNeighbor(sender);
+  if (from == m_neighbors.end())
+  {
+    return;
+  }
+  const LSMessage::lsaKeys &acks = lsMessage.GetLsaAck().acks;
+  for (unsigned int i = 0; i < acks.size(); i++)
+  {
+    std::map<uint32_t, RetransmitEntry>::iterator pending = from->second.retransmit.find(acks[i].first);
+    if (pending != from->second.retransmit.end() && pending->second.seqNumber <= acks[i].second)
+    {
+      from->second.retransmit.erase(pending);
+    }
+  }
+}
+
+void LSRoutingProtocol::RetransmitLsas()
+{
+  Time now = Simulator::Now();
+  bool pending = false;
+  for (std::map<uint32_t, NeighborTableEntry>::iterator iter = m_neighbors.begin(); iter != m_neighbors.end(); iter++)
+  {
+    // Everything due for the neighbor goes out together in LS_UPDATE packets.
+    std::vector<Ptr<Packet>> due;
+    std::map<uint32_t, RetransmitEntry> &retransmit = iter->second.retransmit;
+    for (std::map<uint32_t, RetransmitEntry>::iterator entry = retransmit.begin(); entry != retransmit.end(); entry++)
+    {
+      pending = true;
+      if (entry->second.lastSent + m_lsaRetransmitInterval <= now)
+      {
+        due.push_back(entry->second.packet->Copy());
+        entry->second.lastSent = now;
+      }
+    }
+    std::vector<Ptr<Packet>> packets = PackLsUpdates(due, GetMaxPayload(iter->second));
+    for (unsigned int i = 0; i < packets.size(); i++)
+    {
+      SendToNeighbor(iter->second, packets[i]);
+    }
+  }
+  if (pending)
+  {
+    m_retransmitTimer.Schedule(m_lsaRetransmitInterval);
+  }
+}
+
+Ipv4Address LSRoutingProtocol::GetLinkAddress(const NeighborTableEntry &neighbor) const
+{
+  return (neighbor.linkAddr == Ipv4Address()) ? neighbor.neighborAddr : neighbor.linkAddr;
+}
+
+void LSRoutingProtocol::SendToNeighbor(const NeighborTableEntry &neighbor, Ptr<Packet> packet)
+{
+  // Unicast on the interface the neighbor was heard on, to its address on
+  // that link, so no route is needed.
+  Ipv4Address destination = GetLinkAddress(neighbor);
+  for (std::map<Ptr<Socket>, Ipv4InterfaceAddress>::const_iterator i = m_socketAddresses.begin();
+       i != m_socketAddresses.end(); i++)
+  {
+    if (i->second.GetLocal() == neighbor.interfaceAddr)
+    {
+      CountTx(packet);
+      i->first->SendTo(packet, 0, InetSocketAddress(destination, LS_PORT_NUMBER));
+      return;
+    }
+  }
+}
+
+uint32_t LSRoutingProtocol::GetMaxPayload(const NeighborTableEntry &neighbor)
+{
+  return GetMaxPayload(neighbor.interfaceAddr);
+}
+
+uint32_t LSRoutingProtocol::GetMaxPayload(Ipv4Address interfaceAddr)
+{
+  int32_t ipv4If = m_ipv4->GetInterfaceForAddress(interfaceAddr);
+  if (ipv4If < 0)
+  {
+    return 576 - LS_IP_UDP_OVERHEAD;
+  }
+  return m_ipv4->GetMtu(ipv4If) - LS_IP_UDP_OVERHEAD;
+}
+
+uint32_t LSRoutingProtocol::GetAreaMaxPayload(uint32_t area)
+{
+  uint32_t maxPayload = std::numeric_limits<uint32_t>::max();
   for (std::map<Ptr<Socket>, Ipv4InterfaceAddress>::const_iterator i = m_socketAddresses.begin();
        i != m_socketAddresses.end(); i++)
   {
-    Ipv4InterfaceAddress interfaceAddr = i->second;
-    if (originatorAddress == interfaceAddr.GetLocal())
+    if (GetArea(i->second.GetLocal()) == area)
+    {
+      maxPayload = std::min(maxPayload, GetMaxPayload(i->second.GetLocal()));
+    }
+  }
+  return (maxPayload == std::numeric_limits<uint32_t>::max()) ? 576 - LS_IP_UDP_OVERHEAD : maxPayload;
+}
+
+void LSRoutingProtocol::SendDbDesc(NeighborTableEntry &neighbor)
+{
+  neighbor.dbDescSent = true;
+  // Only the LSDB of the area shared with the neighbor
+  LSMessage::lsaKeys summaries;
+  std::map<uint32_t, AreaState>::iterator area = m_areas.find(neighbor.area);
+  if (area != m_areas.end())
+  {
+    const std::map<uint32_t, LSPneighbors> &lsdb = area->second.lsdb;
+    summaries.reserve(lsdb.size());
+    for (std::map<uint32_t, LSPneighbors>::const_iterator iter = lsdb.begin(); iter != lsdb.end(); iter++)
+    {
+      summaries.push_back(std::make_pair(iter->second.originator.Get(), iter->second.seqNumber));
+    }
+  }
+
+  // As many summaries per packet as the link takes; an empty LSDB still
+  // sends one (empty) DB_DESC so the neighbor offers us its own.
+  LSMessage empty = LSMessage(LSMessage::DB_DESC, 0, 1, m_mainAddress);
+  empty.SetDbDesc(LSMessage::lsaKeys());
+  uint32_t perPacket = (GetMaxPayload(neighbor) - empty.GetSerializedSize()) / (IPV4_ADDRESS_SIZE + sizeof(uint32_t));
+  uint32_t first = 0;
+  do
+  {
+    uint32_t last = std::min<uint32_t>(first + perPacket, summaries.size());
+    LSMessage lsMessage = LSMessage(LSMessage::DB_DESC, GetNextSequenceNumber(), 1, m_mainAddress);
+    lsMessage.SetDbDesc(LSMessage::lsaKeys(summaries.begin() + first, summaries.begin() + last));
+    Ptr<Packet> packet = Create<Packet>();
+    packet->AddHeader(lsMessage);
+    SendToNeighbor(neighbor, packet);
+    first = last;
+  } while (first < summaries.size());
+}
+
+void LSRoutingProtocol::ProcessDbDesc(const LSMessage &lsMessage, Ipv4Address sender)
+{
+  std::map<uint32_t, NeighborTableEntry>::iterator from = FindNeighbor(sender);
+  if (from == m_neighbors.end())
+  {
+    return;
+  }
+
+  std::map<uint32_t, AreaState>::iterator area = m_areas.find(from->second.area);
+  if (area == m_areas.end())
+  {
+    return;
+  }
+  // The first summary from a neighbor we have not sent ours to, or that is
+  // restarting and may have missed it, gets ours back: a restarted node
+  // does not know its neighbors yet when they answer its GRACE.
+  if (!from->second.dbDescHeard)
+  {
+    from->second.dbDescHeard = true;
+    if (!from->second.dbDescSent || from->second.graceUntil > Simulator::Now())
+    {
+      SendDbDesc(from->second);
+    }
+  }
+  const LSMessage::lsaKeys &summaries = lsMessage.GetDbDesc().summaries;
+  LSMessage::lsaKeys requests;
+  for (unsigned int i = 0; i < summaries.size(); i++)
+  {
+    if (IsOwnAddress(Ipv4Address(summaries[i].first)))
+    {
+      // The neighbor holds an LSA of ours from before a restart that is newer
+      // than anything we originated since: jump past it so ours wins.
+      if (summaries[i].second >= m_lsaSequenceNumber)
+      {
+        m_lsaSequenceNumber = summaries[i].second;
+        m_fullLsaDue = true;
+        TriggerLsAdvertise();
+      }
+      continue;
+    }
+    std::unordered_map<uint32_t, uint32_t>::iterator seen = area->second.seenSeq.find(summaries[i].first);
+    if (seen == area->second.seenSeq.end() || seen->second < summaries[i].second)
+    {
+      requests.push_back(summaries[i]);
+    }
+  }
+  if (requests.empty())
+  {
+    return;
+  }
+
+  LSMessage request = LSMessage(LSMessage::LSA_REQ, GetNextSequenceNumber(), 1, m_mainAddress);
+  request.SetLsaReq(requests);
+  Ptr<Packet> packet = Create<Packet>();
+  packet->AddHeader(request);
+  SendToNeighbor(from->second, packet);
+}
+
+void LSRoutingProtocol::ProcessLsaReq(const LSMessage &lsMessage, Ipv4Address sender)
+{
+  std::map<uint32_t, NeighborTableEntry>::iterator from = FindNeighbor(sender);
+  if (from == m_neighbors.end())
+  {
+    return;
+  }
+
+  std::map<uint32_t, AreaState>::iterator area = m_areas.find(from->second.area);
+  if (area == m_areas.end())
+  {
+    return;
+  }
+
+  // The requested LSAs go back in as few LS_UPDATE packets as the MTU allows.
+  const LSMessage::lsaKeys &requests = lsMessage.GetLsaReq().requests;
+  std::vector<Ptr<Packet>> lsas;
+  lsas.reserve(requests.size());
+  for (unsigned int i = 0; i < requests.size(); i++)
+  {
+    uint32_t nodeNumber;
+    if (!LookupNode(Ipv4Address(requests[i].first), nodeNumber))
+    {
+      continue;
+    }
+    std::map<uint32_t, LSPneighbors>::iterator lsp = area->second.lsdb.find(nodeNumber);
+    if (lsp == area->second.lsdb.end())
+    {
+      continue;
+    }
+    LSMessage lsa = LSMessage(LSMessage::LSA_m, lsp->second.seqNumber, m_maxTTL, lsp->second.originator);
+    lsa.SetLsA(lsp->second.neighbornodeandCost, lsp->second.summaries);
+    Ptr<Packet> packet = Create<Packet>();
+    packet->AddHeader(lsa);
+    lsas.push_back(packet);
+  }
+  std::vector<Ptr<Packet>> packets = PackLsUpdates(lsas, GetMaxPayload(from->second));
+  for (unsigned int i = 0; i < packets.size(); i++)
+  {
+    SendToNeighbor(from->second, packets[i]);
+  }
+}
+
+void LSRoutingProtocol::SendOnInterfaces(Ptr<Packet> packet, Ipv4Address exclude, uint32_t area)
+{
+  // The message is serialized once into packet.  Each socket needs its own
+  // handle because the lower layers prepend headers to it, so every
+  // interface but the last gets a copy-on-write Copy() sharing that buffer,
+  // and the last one takes the original.
+  std::vector<bool> skip;
+  skip.reserve(m_socketAddresses.size());
+  std::map<Ptr<Socket>, Ipv4InterfaceAddress>::const_iterator last = m_socketAddresses.end();
+  for (std::map<Ptr<Socket>, Ipv4InterfaceAddress>::const_iterator i = m_socketAddresses.begin();
+       i != m_socketAddresses.end(); i++)
+  {
+    skip.push_back(i->second.GetLocal() == exclude || (area != LS_ALL_AREAS && GetArea(i->second.GetLocal()) != area));
+    if (!skip.back())
+    {
+      last = i;
+    }
+  }
+  unsigned int index = 0;
+  for (std::map<Ptr<Socket>, Ipv4InterfaceAddress>::const_iterator i = m_socketAddresses.begin();
+       i != m_socketAddresses.end(); i++)
+  {
+    if (skip[index++])
+    {
+      continue;
+    }
+    Ptr<Packet> pkt = (i == last) ? packet : packet->Copy();
+    Ipv4Address broadcastAddr = i->second.GetLocal().GetSubnetDirectedBroadcast(i->second.GetMask());
+    CountTx(pkt);
+    i->first->SendTo(pkt, 0, InetSocketAddress(broadcastAddr, LS_PORT_NUMBER));
+    if (i == last)
+    {
+      break;
+    }
+  }
+}
+
+void LSRoutingProtocol::SaveSnapshot()
+{
+  WriteSnapshot();
+  m_snapshotTimer.Schedule(m_snapshotInterval);
+}
+
+void LSRoutingProtocol::WriteSnapshot()
+{
+  // Flat array of 32-bit words in host order; the file never leaves the node.
+  std::vector<uint32_t> words;
+  words.push_back(LS_SNAPSHOT_MAGIC);
+  words.push_back(LS_SNAPSHOT_VERSION);
+  words.push_back(m_lsaSequenceNumber);
+  words.push_back(m_areas.size());
+  for (std::map<uint32_t, AreaState>::const_iterator area = m_areas.begin(); area != m_areas.end(); area++)
+  {
+    words.push_back(area->first);
+    words.push_back(area->second.lsdb.size());
+    for (std::map<uint32_t, LSPneighbors>::const_iterator lsp = area->second.lsdb.begin();
+         lsp != area->second.lsdb.end(); lsp++)
+    {
+      words.push_back(lsp->first);
+      words.push_back(lsp->second.originator.Get());
+      words.push_back(lsp->second.seqNumber);
+      words.push_back(lsp->second.neighbornodeandCost.size());
+      words.push_back(lsp->second.summaries.size());
+      for (unsigned int i = 0; i < lsp->second.neighbornodeandCost.size(); i++)
+      {
+        words.push_back(lsp->second.neighbornodeandCost[i].first);
+        words.push_back(lsp->second.neighbornodeandCost[i].second);
+      }
+      for (unsigned int i = 0; i < lsp->second.summaries.size(); i++)
+      {
+        words.push_back(lsp->second.summaries[i].first);
+        words.push_back(lsp->second.summaries[i].second);
+      }
+    }
+  }
+  words.push_back(m_routingTable.size());
+  for (std::map<uint32_t, RoutingTableEntry>::const_iterator route = m_routingTable.begin();
+       route != m_routingTable.end(); route++)
+  {
+    words.push_back(route->first);
+    words.push_back(route->second.area);
+    words.push_back(route->second.cost);
+    words.push_back(route->second.nextHops.size());
+    for (unsigned int i = 0; i < route->second.nextHops.size(); i++)
+    {
+      words.push_back(route->second.nextHops[i].nodeNum);
+      words.push_back(route->second.nextHops[i].addr.Get());
+      words.push_back(route->second.nextHops[i].interfaceAddr.Get());
+    }
+  }
+
+  std::string staging = m_snapshotFile + ".tmp";
+  std::ofstream out(staging.c_str(), std::ios::binary | std::ios::trunc);
+  out.write((const char *)words.data(), words.size() * sizeof(uint32_t));
+  out.close();
+  if (!out || std::rename(staging.c_str(), m_snapshotFile.c_str()) != 0)
+  {
+    ERROR_LOG("Cannot write LSDB snapshot " << m_snapshotFile);
+  }
+}
+
+bool LSRoutingProtocol::LoadSnapshot()
+{
+  int fd = open(m_snapshotFile.c_str(), O_RDONLY);
+  if (fd < 0)
+  {
+    return false;
+  }
+  struct stat info;
+  if (fstat(fd, &info) != 0 || info.st_size < (off_t)(5 * sizeof(uint32_t)))
+  {
+    close(fd);
+    return false;
+  }
+  void *mapped = mmap(0, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapped == MAP_FAILED)
+  {
+    return false;
+  }
+
+  // Parse the mapped words into temporaries first, so that a truncated or
+  // foreign file leaves us with a clean cold start.
+  const uint32_t *pos = (const uint32_t *)mapped;
+  const uint32_t *end = pos + info.st_size / sizeof(uint32_t);
+  bool ok = true;
+  std::function<uint32_t()> next = [&]() -> uint32_t {
+    if (pos == end)
+    {
+      ok = false;
+      return 0;
+    }
+    return *pos++;
+  };
+
+  std::map<uint32_t, std::map<uint32_t, LSPneighbors>> lsdbs;
+  std::map<uint32_t, RoutingTableEntry> routes;
+  uint32_t sequenceNumber = 0;
+  if (next() != LS_SNAPSHOT_MAGIC || next() != LS_SNAPSHOT_VERSION)
+  {
+    ok = false;
+  }
+  if (ok)
+  {
+    sequenceNumber = next();
+    uint32_t nAreas = next();
+    for (uint32_t a = 0; ok && a < nAreas; a++)
+    {
+      std::map<uint32_t, LSPneighbors> &lsdb = lsdbs[next()];
+      uint32_t nLsas = next();
+      for (uint32_t l = 0; ok && l < nLsas; l++)
+      {
+        LSPneighbors &lsp = lsdb[next()];
+        lsp.originator = Ipv4Address(next());
+        lsp.interfaceAd = lsp.originator;
+        lsp.seqNumber = next();
+        uint32_t nLinks = next();
+        uint32_t nSummaries = next();
+        if ((uint64_t)(nLinks + (uint64_t)nSummaries) * 2 > (uint64_t)(end - pos))
+        {
+          ok = false;
+          break;
+        }
+        for (uint32_t i = 0; i < nLinks; i++)
+        {
+          uint32_t node = next();
+          lsp.neighbornodeandCost.push_back(std::make_pair(node, next()));
+        }
+        for (uint32_t i = 0; i < nSummaries; i++)
+        {
+          uint32_t node = next();
+          lsp.summaries.push_back(std::make_pair(node, next()));
+        }
+      }
+    }
+    uint32_t nRoutes = next();
+    for (uint32_t r = 0; ok && r < nRoutes; r++)
+    {
+      uint32_t destNode = next();
+      RoutingTableEntry &route = routes[destNode];
+      route.destAddr = ResolveNodeIpAddress(destNode);
+      route.area = next();
+      route.cost = next();
+      route.backup.nodeNum = LS_NO_NODE;
+      route.backupCost = LS_INFINITY;
+      uint32_t nHops = next();
+      for (uint32_t i = 0; ok && i < nHops; i++)
+      {
+        EcmpNextHop hop;
+        hop.nodeNum = next();
+        hop.addr = Ipv4Address(next());
+        hop.interfaceAddr = Ipv4Address(next());
+        // Interfaces may have changed across the restart.
+        if (IsOwnAddress(hop.interfaceAddr))
+        {
+          route.nextHops.push_back(hop);
+        }
+      }
+    }
+  }
+  munmap(mapped, info.st_size);
+  if (!ok)
+  {
+    ERROR_LOG("Ignoring unreadable LSDB snapshot " << m_snapshotFile);
+    return false;
+  }
+
+  // Sequence numbers carry on from the snapshot; a neighbor holding a newer
+  // LSA of ours still makes ProcessDbDesc jump past it.
+  m_lsaSequenceNumber = sequenceNumber;
+  uint32_t selfNode = GetSelfNode();
+  for (std::map<uint32_t, std::map<uint32_t, LSPneighbors>>::iterator saved = lsdbs.begin(); saved != lsdbs.end();
+       saved++)
+  {
+    std::map<uint32_t, AreaState>::iterator area = m_areas.find(saved->first);
+    if (area == m_areas.end())
     {
-      return true;
+      continue;
+    }
+    for (std::map<uint32_t, LSPneighbors>::iterator lsp = saved->second.begin(); lsp != saved->second.end(); lsp++)
+    {
+      lsp->second.installTime = Simulator::Now();
+      LSPneighbors &stored = area->second.lsdb[lsp->first];
+      stored = lsp->second;
+      area->second.seenSeq[stored.originator.Get()] = stored.seqNumber;
+      area->second.spf.UpdateAdjacency(lsp->first, GetSpfAdjacency(area->first, lsp->first, stored));
+      if (lsp->first == selfNode)
+      {
+        for (unsigned int i = 0; i < stored.neighbornodeandCost.size(); i++)
+        {
+          m_graceNeighbors.push_back(stored.neighbornodeandCost[i].first);
+        }
+      }
+      else
+      {
+        ArmTimer(LSA_AGE_TIMER, lsp->first, m_lsaMaxAge);
+      }
     }
   }
-  return false;
+  for (std::map<uint32_t, RoutingTableEntry>::iterator route = routes.begin(); route != routes.end(); route++)
+  {
+    RoutingTableEntry &r = route->second;
+    if (r.nextHops.empty())
+    {
+      continue;
+    }
+    r.nextHopNum = r.nextHops[0].nodeNum;
+    r.nextHopAddr = r.nextHops[0].addr;
+    r.interfaceAddr = r.nextHops[0].interfaceAddr;
+    m_routingTable[route->first] = r;
+  }
+  InstallRoutes();
+  RebuildFib();
+  return true;
+}
+
+void LSRoutingProtocol::SendGrace(Time period)
+{
+  LSMessage lsMessage = LSMessage(LSMessage::GRACE, GetNextSequenceNumber(), 1, m_mainAddress);
+  lsMessage.SetGrace((uint32_t)period.GetMilliSeconds());
+  Ptr<Packet> packet = Create<Packet>();
+  packet->AddHeader(lsMessage);
+  BroadcastPacket(packet);
+}
+
+void LSRoutingProtocol::ProcessGrace(const LSMessage &lsMessage, Ipv4Address sender)
+{
+  std::map<uint32_t, NeighborTableEntry>::iterator from = FindNeighbor(sender);
+  if (from == m_neighbors.end())
+  {
+    // Already given up on; HELLO brings it back as a new neighbor.
+    return;
+  }
+  uint32_t period = lsMessage.GetGrace().gracePeriod;
+  if (period == 0)
+  {
+    from->second.graceUntil = Seconds(0);
+    return;
+  }
+  // Keep the adjacency, and with it our LSA and routes, while it restarts.
+  // It has no neighbors yet and would drop a DB_DESC now; the exchange
+  // starts once it answers our HELLO or sends its own summary.
+  from->second.graceUntil = Simulator::Now() + MilliSeconds(period);
+  from->second.dbDescSent = false;
+  from->second.dbDescHeard = false;
+}
+
+void LSRoutingProtocol::ExitGracefulRestart()
+{
+  if (!m_restarting)
+  {
+    return;
+  }
+  m_restarting = false;
+  m_graceTimer.Cancel();
+  m_graceNeighbors.clear();
+  SendGrace(Seconds(0));
+  m_fullLsaDue = true;
+  LSAdvertise();
+  ScheduleSpf();
+}
+
+void LSRoutingProtocol::ScheduleSpf()
+{
+  if (m_spfTimer.IsRunning())
+  {
+    // Already pending; this change rides along with that run.  One
+    // originator may have several LSAs in it; the engine nets them out.
+    return;
+  }
+  Time now = Simulator::Now();
+  Time delay;
+  if (m_spfRunCount == 0 || m_lastSpfTime + m_spfHoldCurrent + m_spfHoldCurrent <= now)
+  {
+    // Network has been quiet: react quickly and reset the backoff.
+    delay = m_spfInitialDelay;
+    m_spfHoldCurrent = m_spfHoldTime;
+  }
+  else
+  {
+    Time earliest = m_lastSpfTime + m_spfHoldCurrent;
+    delay = (earliest > now) ? earliest - now : Seconds(0);
+    m_spfHoldCurrent = Min(m_spfHoldCurrent + m_spfHoldCurrent, m_spfMaxWait);
+  }
+  m_spfTimer.Schedule(delay);
+}
+
+void LSRoutingProtocol::RunScheduledSpf()
+{
+  if (m_restarting)
+  {
+    // Keep the snapshot routes; ExitGracefulRestart() schedules the run.
+    return;
+  }
+  m_lastSpfTime = Simulator::Now();
+  m_spfRunCount++;
+  std::clock_t start = std::clock();
+  std::chrono::steady_clock::time_point wallStart = std::chrono::steady_clock::now();
+  IncrementalSpf();
+  uint64_t wallNs =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - wallStart).count();
+  m_spfCpuSeconds += double(std::clock() - start) / CLOCKS_PER_SEC;
+
+  uint32_t bucket = 0;
+  while (bucket + 1 < m_spfHistogram.size() && (uint64_t(1) << bucket) * 1000 <= wallNs)
+  {
+    bucket++;
+  }
+  m_spfHistogram[bucket]++;
+  UpdateLsdbStats();
+  m_spfTrace(NanoSeconds(wallNs), m_lsdbSize.Get());
+  InstallRoutes();
+  RebuildFib();
+}
+
+void LSRoutingProtocol::RebuildFib()
+{
+  // Routes are precomputed here so that the forwarding path only does a
+  // lookup and hands out a reference.
+  m_fib.Clear();
+  std::vector<Ptr<Ipv4Route>> routes;
+  for (std::map<uint32_t, RoutingTableEntry>::const_iterator iter = m_routingTable.begin();
+       iter != m_routingTable.end(); iter++)
+  {
+    const RoutingTableEntry &entry = iter->second;
+    routes.clear();
+    for (unsigned int i = 0; i < entry.nextHops.size(); i++)
+    {
+      int32_t interface = m_ipv4->GetInterfaceForAddress(entry.nextHops[i].interfaceAddr);
+      if (interface < 0)
+      {
+        continue;
+      }
+      Ptr<Ipv4Route> route = Create<Ipv4Route>();
+      route->SetDestination(entry.destAddr);
+      route->SetGateway(entry.nextHops[i].addr);
+      route->SetSource(entry.nextHops[i].interfaceAddr);
+      route->SetOutputDevice(m_ipv4->GetNetDevice(interface));
+      routes.push_back(route);
+    }
+    if (!routes.empty())
+    {
+      m_fib.AddRoute(entry.destAddr, Ipv4Mask::GetOnes(), routes);
+    }
+  }
+  m_fib.Build();
 }
 
-void LSRoutingProtocol::AuditPings()
+void LSRoutingProtocol::InstallRoutes()
 {
-  std::map<uint32_t, Ptr<PingRequest>>::iterator iter;
-  for (iter = m_pingTracker.begin(); iter != m_pingTracker.end();)
+  // Both maps are ordered by destination node, so one merge pass finds the
+  // routes to withdraw, add or replace; unchanged ones are not touched.
+  std::map<uint32_t, RoutingTableEntry>::const_iterator route = m_routingTable.begin();
+  std::map<uint32_t, InstalledRoute>::iterator installed = m_installedRoutes.begin();
+  while (route != m_routingTable.end() || installed != m_installedRoutes.end())
   {
-    Ptr<PingRequest> pingRequest = iter->second;
-    if (pingRequest->GetTimestamp().GetMilliSeconds() + m_pingTimeout.GetMilliSeconds() <= Simulator::Now().GetMilliSeconds())
+    if (route == m_routingTable.end() || (installed != m_installedRoutes.end() && installed->first < route->first))
+    {
+      RemoveHostRoute(installed->second);
+      m_installedRoutes.erase(installed++);
+      NoteRouteChange();
+      continue;
+    }
+
+    int32_t interface = m_ipv4->GetInterfaceForAddress(route->second.interfaceAddr);
+    if (interface < 0)
+    {
+      route++;
+      continue;
+    }
+    InstalledRoute wanted = {route->second.destAddr, route->second.nextHopAddr, (uint32_t)interface,
+                             route->second.cost, Ipv4Address::GetAny(), 0, 0};
+    // The alternate sits next to the primary with a higher metric, so the
+    // static table falls back to it if the primary is withdrawn.
+    int32_t backupInterface = -1;
+    if (route->second.backup.nodeNum != LS_NO_NODE)
+    {
+      backupInterface = m_ipv4->GetInterfaceForAddress(route->second.backup.interfaceAddr);
+    }
+    if (backupInterface >= 0)
     {
-      DEBUG_LOG("Ping expired. Message: " << pingRequest->GetPingMessage()
-                                          << " Timestamp: " << pingRequest->GetTimestamp().GetMilliSeconds()
-                                          << " CurrentTime: " << Simulator::Now().GetMilliSeconds());
-      // Remove stale entries
-      m_pingTracker.erase(iter++);
+      wanted.backupAddr = route->second.backup.addr;
+      wanted.backupInterface = (uint32_t)backupInterface;
+      wanted.backupMetric = std::max(route->second.backupCost, route->second.cost + 1);
+    }
+    if (installed == m_installedRoutes.end() || route->first < installed->first)
+    {
+      AddHostRoute(wanted);
+      m_installedRoutes.insert(installed, std::make_pair(route->first, wanted));
+      NoteRouteChange();
     }
     else
     {
-      ++iter;
+      const InstalledRoute &current = installed->second;
+      bool primaryChanged = current.destAddr != wanted.destAddr || current.nextHopAddr != wanted.nextHopAddr ||
+                            current.interface != wanted.interface || current.metric != wanted.metric;
+      if (primaryChanged || current.backupAddr != wanted.backupAddr ||
+          current.backupInterface != wanted.backupInterface || current.backupMetric != wanted.backupMetric)
+      {
+        RemoveHostRoute(current);
+        AddHostRoute(wanted);
+        installed->second = wanted;
+        // Only a change in the path actually used counts as a route change.
+        if (primaryChanged)
+        {
+          NoteRouteChange();
+        }
+      }
+      installed++;
     }
+    route++;
+  }
+}
+
+void LSRoutingProtocol::AddHostRoute(const InstalledRoute &route)
+{
+  m_staticRouting->AddHostRouteTo(route.destAddr, route.nextHopAddr, route.interface, route.metric);
+  if (route.backupAddr != Ipv4Address::GetAny())
+  {
+    m_staticRouting->AddHostRouteTo(route.destAddr, route.backupAddr, route.backupInterface, route.backupMetric);
+  }
+}
+
+void LSRoutingProtocol::RemoveHostRoute(const InstalledRoute &route)
+{
+  RemoveStaticRoute(route.destAddr, route.nextHopAddr, route.interface);
+  if (route.backupAddr != Ipv4Address::GetAny())
+  {
+    RemoveStaticRoute(route.destAddr, route.backupAddr, route.backupInterface);
+  }
+}
+
+void LSRoutingProtocol::RemoveStaticRoute(Ipv4Address destAddr, Ipv4Address nextHopAddr, uint32_t interface)
+{
+  for (uint32_t i = 0; i < m_staticRouting->GetNRoutes(); i++)
+  {
+    Ipv4RoutingTableEntry entry = m_staticRouting->GetRoute(i);
+    if (entry.IsHost() && entry.GetDest() == destAddr && entry.GetGateway() == nextHopAddr &&
+        entry.GetInterface() == interface)
+    {
+      m_staticRouting->RemoveRoute(i);
+      return;
+    }
+  }
+}
+
+uint64_t
+LSRoutingProtocol::GetLsaReceivedCount() const
+{
+  return m_lsaReceivedCount;
+}
+
+uint64_t
+LSRoutingProtocol::GetSpfRunCount() const
+{
+  return m_spfRunCount;
+}
+
+double
+LSRoutingProtocol::GetSpfCpuSeconds() const
+{
+  return m_spfCpuSeconds;
+}
+
+Time
+LSRoutingProtocol::GetLastRouteChangeTime() const
+{
+  return m_lastRouteChange;
+}
+
+uint32_t
+LSRoutingProtocol::GetRouteCount() const
+{
+  return m_installedRoutes.size();
+}
+
+uint64_t
+LSRoutingProtocol::GetRouteChangeCount() const
+{
+  return m_routeChanges.Get();
+}
+
+uint64_t
+LSRoutingProtocol::GetLsdbMemoryUsage() const
+{
+  return m_lsdbMemory.Get();
+}
+
+void LSRoutingProtocol::NoteRouteChange()
+{
+  m_lastRouteChange = Simulator::Now();
+  m_routeChanges++;
+}
+
+void LSRoutingProtocol::CountRx(Ptr<const Packet> packet)
+{
+  // The message type is the first byte of the LS header.
+  uint8_t type;
+  if (packet->CopyData(&type, 1) != 1 || type >= m_messageCounters.size())
+  {
+    return;
+  }
+  m_messageCounters[type].rxPackets++;
+  m_messageCounters[type].rxBytes += packet->GetSize();
+  m_rxTrace(packet, type);
+}
+
+void LSRoutingProtocol::CountTx(Ptr<const Packet> packet)
+{
+  m_controlTxBytes += packet->GetSize();
+  uint8_t type;
+  if (packet->CopyData(&type, 1) != 1 || type >= m_messageCounters.size())
+  {
+    return;
+  }
+  m_messageCounters[type].txPackets++;
+  m_messageCounters[type].txBytes += packet->GetSize();
+  m_txTrace(packet, type);
+}
+
+void LSRoutingProtocol::UpdateLsdbStats()
+{
+  uint32_t lsas = 0;
+  uint64_t bytes = 0;
+  for (std::map<uint32_t, AreaState>::const_iterator area = m_areas.begin(); area != m_areas.end(); area++)
+  {
+    const AreaState &state = area->second;
+    lsas += state.lsdb.size();
+    for (std::map<uint32_t, LSPneighbors>::const_iterator lsp = state.lsdb.begin(); lsp != state.lsdb.end(); lsp++)
+    {
+      bytes += LS_MAP_NODE_OVERHEAD + sizeof(std::pair<const uint32_t, LSPneighbors>) +
+               (lsp->second.neighbornodeandCost.capacity() + lsp->second.summaries.capacity()) *
+                   sizeof(std::pair<uint32_t, uint32_t>);
+    }
+    bytes += state.seenSeq.size() * (sizeof(std::pair<const uint32_t, uint32_t>) + sizeof(void *)) +
+             state.seenSeq.bucket_count() * sizeof(void *);
+    bytes += state.spf.GetMemoryUsage();
+  }
+  m_lsdbSize = lsas;
+  m_lsdbMemory = bytes;
+}
+
+void LSRoutingProtocol::Dijkstra()
+{
+  std::vector<uint32_t> changed;
+  for (std::map<uint32_t, AreaState>::iterator area = m_areas.begin(); area != m_areas.end(); area++)
+  {
+    area->second.spf.ComputeFull(GetSelfNode(), changed);
+  }
+  std::sort(changed.begin(), changed.end());
+  changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+  m_routingTable.clear();
+  for (unsigned int i = 0; i < changed.size(); i++)
+  {
+    UpdateRoute(changed[i]);
+  }
+  ComputeLfas(changed);
+  UpdateSummaries();
+}
+
+void LSRoutingProtocol::IncrementalSpf()
+{
+  // The engines repair their trees in place and report the destinations whose
+  // cost or first hops moved; only their routing table entries are rewritten.
+  // A destination may be reported by several areas, and after a rebuild the
+  // routes of every area are rechecked, including ones it no longer reaches.
+  std::vector<uint32_t> changed;
+  bool rebuilt = false;
+  for (std::map<uint32_t, AreaState>::iterator area = m_areas.begin(); area != m_areas.end(); area++)
+  {
+    rebuilt |= area->second.spf.Compute(GetSelfNode(), changed);
+  }
+  if (rebuilt)
+  {
+    for (std::map<uint32_t, RoutingTableEntry>::iterator iter = m_routingTable.begin(); iter != m_routingTable.end();
+         iter++)
+    {
+      changed.push_back(iter->first);
+    }
+  }
+  if (m_areas.size() > 1)
+  {
+    std::sort(changed.begin(), changed.end());
+    changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+  }
+  for (unsigned int i = 0; i < changed.size(); i++)
+  {
+    UpdateRoute(changed[i]);
+  }
+  ComputeLfas(changed);
+  UpdateSummaries();
+}
+
+void LSRoutingProtocol::ComputeLfas(std::vector<uint32_t> &changed)
+{
+  if (!m_lfaEnabled)
+  {
+    return;
+  }
+  // An LSDB change can move the neighbors' distances without moving our
+  // own routes; the engines report those destinations as well.
+  for (std::map<uint32_t, AreaState>::iterator area = m_areas.begin(); area != m_areas.end(); area++)
+  {
+    std::vector<uint32_t> candidates;
+    for (std::map<uint32_t, NeighborTableEntry>::iterator iter = m_neighbors.begin(); iter != m_neighbors.end(); iter++)
+    {
+      if (iter->second.area == area->first)
+      {
+        candidates.push_back(iter->first);
+      }
+    }
+    area->second.spf.ComputeAlternates(candidates, changed);
+  }
+  std::sort(changed.begin(), changed.end());
+  changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+  for (unsigned int i = 0; i < changed.size(); i++)
+  {
+    std::map<uint32_t, RoutingTableEntry>::iterator iter = m_routingTable.find(changed[i]);
+    if (iter == m_routingTable.end())
+    {
+      continue;
+    }
+    RoutingTableEntry &r = iter->second;
+    r.backup.nodeNum = LS_NO_NODE;
+    std::map<uint32_t, AreaState>::iterator area = m_areas.find(r.area);
+    if (area == m_areas.end())
+    {
+      continue;
+    }
+    uint32_t cost;
+    uint32_t alternate = area->second.spf.GetAlternate(iter->first, cost);
+    std::map<uint32_t, NeighborTableEntry>::iterator neighbor = m_neighbors.find(alternate);
+    if (alternate == LSSpfEngine::NO_NODE || neighbor == m_neighbors.end())
+    {
+      continue;
+    }
+    EcmpNextHop hop = {alternate, GetLinkAddress(neighbor->second), neighbor->second.interfaceAddr};
+    r.backup = hop;
+    r.backupCost = cost;
+  }
+}
+
+LSRoutingProtocol::neighborInfo
+LSRoutingProtocol::GetSpfAdjacency(uint32_t area, uint32_t originator, const LSPneighbors &lsp)
+{
+  // Our own summaries are derived from our other areas and lead nowhere new.
+  // A border router attached to the backbone takes inter-area routes from
+  // the backbone only, as summaries in another area may have been derived
+  // from its own.
+  bool useSummaries = !lsp.summaries.empty() && originator != GetSelfNode()
+                      && (area == LS_BACKBONE_AREA || m_areas.find(LS_BACKBONE_AREA) == m_areas.end());
+  if (!useSummaries)
+  {
+    return lsp.neighbornodeandCost;
+  }
+  neighborInfo adjacency = lsp.neighbornodeandCost;
+  adjacency.insert(adjacency.end(), lsp.summaries.begin(), lsp.summaries.end());
+  return adjacency;
+}
+
+void LSRoutingProtocol::UpdateSummaries()
+{
+  if (m_areas.size() < 2)
+  {
+    return;
+  }
+  uint32_t selfNode = GetSelfNode();
+  bool changed = false;
+  for (std::map<uint32_t, AreaState>::iterator into = m_areas.begin(); into != m_areas.end(); into++)
+  {
+    // Destination -> our cheapest cost to it through the other areas
+    std::map<uint32_t, uint32_t> best;
+    for (std::map<uint32_t, AreaState>::iterator from = m_areas.begin(); from != m_areas.end(); from++)
+    {
+      if (from == into)
+      {
+        continue;
+      }
+      const std::map<uint32_t, LSPneighbors> &lsdb = from->second.lsdb;
+      for (std::map<uint32_t, LSPneighbors>::const_iterator lsp = lsdb.begin(); lsp != lsdb.end(); lsp++)
+      {
+        // Every area hears about the nodes of the others; non-backbone
+        // areas also get what the backbone learned from further away.
+        std::vector<uint32_t> destinations(1, lsp->first);
+        if (from->first == LS_BACKBONE_AREA)
+        {
+          for (unsigned int i = 0; i < lsp->second.summaries.size(); i++)
+          {
+            destinations.push_back(lsp->second.summaries[i].first);
+          }
+        }
+        for (unsigned int i = 0; i < destinations.size(); i++)
+        {
+          uint32_t dest = destinations[i];
+          uint32_t cost = from->second.spf.GetCost(dest);
+          if (dest == selfNode || cost == LSSpfEngine::INFINITE_COST || into->second.lsdb.count(dest))
+          {
+            continue;
+          }
+          std::map<uint32_t, uint32_t>::iterator known = best.find(dest);
+          if (known == best.end() || cost < known->second)
+          {
+            best[dest] = cost;
+          }
+        }
+      }
+    }
+    neighborInfo summaries(best.begin(), best.end());
+    if (summaries != into->second.summaries)
+    {
+      into->second.summaries.swap(summaries);
+      changed = true;
+    }
+  }
+  if (changed)
+  {
+    TriggerLsAdvertise();
   }
-  // Rechedule timer
-  m_auditPingsTimer.Schedule(m_pingTimeout);
 }
 
+void LSRoutingProtocol::UpdateRoute(uint32_t destNode)
+{
+  // Pick the area whose tree gives the preferred path to the destination.
+  AreaState *best = 0;
+  uint32_t bestArea = LS_BACKBONE_AREA;
+  bool bestIntra = false;
+  for (std::map<uint32_t, AreaState>::iterator area = m_areas.begin(); area != m_areas.end(); area++)
+  {
+    uint32_t cost = area->second.spf.GetCost(destNode);
+    if (cost == LSSpfEngine::INFINITE_COST)
+    {
+      continue;
+    }
+    bool intra = area->second.lsdb.count(destNode) > 0;
+    if (best == 0 || (intra && !bestIntra) || (intra == bestIntra && cost < best->spf.GetCost(destNode)))
+    {
+      best = &area->second;
+      bestArea = area->first;
+      bestIntra = intra;
+    }
+  }
+  if (best == 0)
+  {
+    m_routingTable.erase(destNode);
+    return;
+  }
+
+  RoutingTableEntry r;
+  r.destAddr = ResolveNodeIpAddress(destNode);
+  r.cost = best->spf.GetCost(destNode);
+  r.area = bestArea;
+  r.backup.nodeNum = LS_NO_NODE;
+  r.backupCost = LS_INFINITY;
+  if (destNode != GetSelfNode())
+  {
+    const std::vector<uint32_t> &nextHops = best->spf.GetNextHops(destNode);
+    for (unsigned int i = 0; i < nextHops.size(); i++)
+    {
+      uint32_t nextHopNum = nextHops[i];
+      std::map<uint32_t, NeighborTableEntry>::iterator it = m_neighbors.find(nextHopNum);
+      if (it == m_neighbors.end())
+      {
+        // No longer adjacent; our own LSA will be refreshed shortly.
+        continue;
+      }
+      EcmpNextHop hop = {nextHopNum, GetLinkAddress(it->second), it->second.interfaceAddr};
+      r.nextHops.push_back(hop);
+    }
+  }
+  if (r.nextHops.empty())
+  {
+    m_routingTable.erase(destNode);
+    return;
+  }
+  // The first equal-cost next hop doubles as the primary one.
+  r.nextHopNum = r.nextHops[0].nodeNum;
+  r.nextHopAddr = r.nextHops[0].addr;
+  r.interfaceAddr = r.nextHops[0].interfaceAddr;
+  m_routingTable[destNode] = r;
+}
+
+bool LSRoutingProtocol::IsOwnAddress(Ipv4Address originatorAddress)
+{
+  // m_ownAddresses mirrors the interfaces in m_socketAddresses, kept sorted
+  return std::binary_search(m_ownAddresses.begin(), m_ownAddresses.end(), originatorAddress.Get());
+}
+
+
 uint32_t
 LSRoutingProtocol::GetNextSequenceNumber()
 {
@@ -906,6 +2789,14 @@ LSRoutingProtocol::GetNextSequenceNumber()
   return m_currentSequenceNumber;
 }
 
+uint32_t
+LSRoutingProtocol::GetNextLsaSequenceNumber()
+{
+  // Never wraps in practice (one LSA per LsaMinInterval), so LSA instances
+  // compare with plain integer order.
+  return ++m_lsaSequenceNumber;
+}
+
 void LSRoutingProtocol::NotifyInterfaceUp(uint32_t i)
 {
   m_staticRouting->NotifyInterfaceUp(i);
@@ -929,8 +2820,16 @@ void LSRoutingProtocol::SetIpv4(Ptr<Ipv4> ipv4)
   NS_ASSERT(m_ipv4 == 0);
   NS_LOG_DEBUG("Created ls::RoutingProtocol");
   // Configure timers
-  m_auditPingsTimer.SetFunction(&LSRoutingProtocol::AuditPings, this);
+  m_wheelTimer.SetFunction(&LSRoutingProtocol::RunTimers, this);
   m_auditNeighborsTimer.SetFunction(&LSRoutingProtocol::AuditNeighbors, this);
+  m_spfTimer.SetFunction(&LSRoutingProtocol::RunScheduledSpf, this);
+  m_lsaOriginateTimer.SetFunction(&LSRoutingProtocol::LSAdvertise, this);
+  m_lsaRefreshTimer.SetFunction(&LSRoutingProtocol::RefreshLsa, this);
+  m_retransmitTimer.SetFunction(&LSRoutingProtocol::RetransmitLsas, this);
+  m_ackTimer.SetFunction(&LSRoutingProtocol::FlushAcks, this);
+  m_bfdTimer.SetFunction(&LSRoutingProtocol::BfdTick, this);
+  m_snapshotTimer.SetFunction(&LSRoutingProtocol::SaveSnapshot, this);
+  m_graceTimer.SetFunction(&LSRoutingProtocol::ExitGracefulRestart, this);
  // m_Hello_Timer.SetFunction(&LSRoutingProtocol::BroadcastHello(), this);
   m_ipv4 = ipv4;
   m_staticRouting->SetIpv4(m_ipv4);
@@ -26,12 +26,18 @@
 #include "ns3/random-variable-stream.h"
 #include "ns3/socket.h"
 #include "ns3/timer.h"
+#include "ns3/traced-callback.h"
+#include "ns3/traced-value.h"
 
+#include "ns3/ls-fib.h"
 #include "ns3/ls-message.h"
+#include "ns3/ls-spf-engine.h"
+#include "ns3/ls-timer-wheel.h"
 #include "ns3/penn-routing-protocol.h"
 #include "ns3/ping-request.h"
 
 #include <map>
+#include <unordered_map>
 #include <vector>
 
 using namespace ns3;
@@ -81,6 +87,20 @@ public:
 
   virtual void SetAddressNodeMap(std::map<Ipv4Address, uint32_t> addressNodeMap);
 
+  /**
+   * \brief Put an interface into an area; interfaces default to the backbone, area 0.
+   *
+   * LSAs are flooded only within the area they were originated in, so each
+   * node keeps one LSDB and one shortest path tree per area it has an
+   * interface in.  A node with interfaces in several areas is an area border
+   * router and advertises into each area the destinations it reaches through
+   * the others.  Must be called before the protocol is initialized.
+   *
+   * \param interface Ipv4 interface index.
+   * \param area Area ID.
+   */
+  void SetInterfaceArea(uint32_t interface, uint32_t area);
+
   // Message Handling
   /**
    * \brief Data Receive Callback function for UDP control plane sockets.
@@ -89,23 +109,276 @@ public:
    */
 
   void RecvLSMessage(Ptr<Socket> socket);
-  void ProcessPingReq(LSMessage lsMessage);
-  void ProcessPingRsp(LSMessage lsMessage);
+  void ProcessPingReq(const LSMessage &lsMessage);
+  void ProcessPingRsp(const LSMessage &lsMessage);
   //*******************MS-1*******************//
-  void ProcessHelloReq(LSMessage lsMessage);
-  void ProcessHelloRsp(LSMessage lsMessage, Ipv4Address interfaceAd);
+  void ProcessHelloReq(const LSMessage &lsMessage);
+  void ProcessHelloRsp(const LSMessage &lsMessage, Ipv4Address interfaceAd, Ipv4Address senderAd);
   void BroadcastHello();
 
   // Periodic Audit
-  void AuditPings();
    //*******************MS-1*******************//
   void AuditNeighbors();
+  /**
+   * \brief Send fast hellos to all neighbors and expire silent sessions.
+   *
+   * Runs every BfdInterval, independently of the HELLO audit.
+   */
+  void BfdTick();
+  void ProcessBfdHello(Ipv4Address sender);
+
+  // Graceful restart
+  /**
+   * \brief Write the LSDB, sequence number and routing table to SnapshotFile.
+   *
+   * The file is written aside and renamed into place, so a crash while
+   * writing leaves the previous snapshot intact.
+   */
+  void WriteSnapshot();
+  /**
+   * \brief Periodic WriteSnapshot(), every SnapshotInterval.
+   */
+  void SaveSnapshot();
+  /**
+   * \brief Restore the state written by WriteSnapshot() and install its routes.
+   *
+   * \returns false if there is no usable snapshot.
+   */
+  bool LoadSnapshot();
+  /**
+   * \brief Tell the neighbors to keep the adjacency up for period while we restart.
+   *
+   * \param period Grace period; zero announces that the restart is over.
+   */
+  void SendGrace(Time period);
+  /**
+   * \brief A neighbor is restarting (or done): hold its adjacency and resync it.
+   */
+  void ProcessGrace(const LSMessage &lsMessage, Ipv4Address sender);
+  /**
+   * \brief Leave graceful restart: originate our LSA and replace the
+   *        restored routes with the result of a fresh SPF run.
+   *
+   * Runs once every neighbor from the snapshot is back, or when GracePeriod expires.
+   */
+  void ExitGracefulRestart();
+
+  // Expiry events on the shared timer wheel; the id is a node number,
+  // except for pings where it is the sequence number.
+  enum TimerKind
+  {
+    NEIGHBOR_TIMER,
+    BFD_TIMER,
+    PING_TIMER,
+    LSA_AGE_TIMER,
+  };
+  /**
+   * \brief (Re-)arm the expiry event of kind and id to fire after delay.
+   */
+  void ArmTimer(TimerKind kind, uint32_t id, Time delay);
+  void CancelTimer(TimerKind kind, uint32_t id);
+  /**
+   * \brief Advance the timer wheel to now and handle what expired.
+   */
+  void RunTimers();
+  /**
+   * \brief Set the wheel timer for the earliest armed slot, or stop it.
+   */
+  void ScheduleWheel();
+  uint64_t GetWheelTick() const;
+  void RemoveNeighbor(uint32_t neighborNum);
+  /**
+   * \brief Move routes off a lost neighbor without waiting for SPF.
+   *
+   * Routes through the neighbor keep their other equal-cost next hops, or
+   * switch to their loop-free alternate; routes with neither are withdrawn.
+   * The next SPF run replaces them with the reconverged ones.
+   *
+   * \returns true if m_routingTable changed.
+   */
+  bool RepairRoutes(uint32_t neighborNum);
 
   //*******************MS-2*******************//
   void LSAdvertise();
-  void ProcessLsp(LSMessage lsMessage, Ipv4Address interfaceAd );
-  void floodLSA(Ptr<Packet> packet, Ipv4Address fromNode);
+  /**
+   * \brief Periodic re-origination; always sends the full LSA.
+   */
+  void RefreshLsa();
+  /**
+   * \brief Originate our LSA because the local adjacency changed.
+   *
+   * Originations are spaced by at least LsaMinInterval; changes inside that
+   * window are folded into one LSA.
+   */
+  void TriggerLsAdvertise();
+  /**
+   * \brief Install an LSA into the LSDB of the area it arrived in.
+   *
+   * SPF is not scheduled here, so that a batch of LSAs makes one change.
+   *
+   * \param flood The LSA is appended here, serialized, if it is to be flooded on.
+   * \returns true if the SPF adjacency changed.
+   */
+  bool ProcessLsp(LSMessage &lsMessage, Ipv4Address interfaceAd, Ipv4Address sender,
+                  std::vector<Ptr<Packet>> &flood);
+  /**
+   * \brief Process the LSAs following an LS_UPDATE header as one batch.
+   *
+   * \param packet Positioned at the first LSA; the batch is removed from it,
+   *        and everything else too if an LSA cannot be framed.
+   */
+  void ProcessLsUpdate(const LSMessage &lsMessage, Ptr<Packet> packet, Ipv4Address interface,
+                       Ipv4Address sender);
+  void ProcessLsaAck(const LSMessage &lsMessage, Ipv4Address sender);
+  void ProcessDbDesc(const LSMessage &lsMessage, Ipv4Address sender);
+  void ProcessLsaReq(const LSMessage &lsMessage, Ipv4Address sender);
+  /**
+   * \brief Flood an LSA on the interfaces of its area but the ingress one, reliably.
+   *
+   * The LSA is put on the retransmission list of every neighbor it is sent
+   * to, and resent to it every LsaRetransmitInterval until acknowledged.
+   *
+   * \param lsMessage LSA to flood.
+   * \param ingress Interface the LSA was received on, or Ipv4Address::GetAny().
+   * \param fromNeighbor Node the LSA was received from, or LS_NO_NODE.
+   * \param area Area the LSA belongs to.
+   */
+  void floodLSA(const LSMessage &lsMessage, Ipv4Address ingress, uint32_t fromNeighbor, uint32_t area);
+  /**
+   * \brief The retransmission half of floodLSA(); the caller sends the packet.
+   *
+   * \returns The serialized LSA.
+   */
+  Ptr<Packet> QueueLsaFlood(const LSMessage &lsMessage, Ipv4Address ingress, uint32_t fromNeighbor, uint32_t area);
+  /**
+   * \brief Send LSAs queued by QueueLsaFlood(), packed into LS_UPDATE packets.
+   */
+  void FloodLsas(const std::vector<Ptr<Packet>> &lsas, Ipv4Address ingress, uint32_t area);
+  /**
+   * \brief Group serialized LSAs into LS_UPDATE packets of at most maxPayload bytes.
+   *
+   * A group of one is returned as the plain LSA packet.
+   */
+  std::vector<Ptr<Packet>> PackLsUpdates(const std::vector<Ptr<Packet>> &lsas, uint32_t maxPayload);
+  void RetransmitLsas();
+  void FlushAcks();
+  /**
+   * \brief Full SPF run over the LSDB; rebuilds the tree and the routing table.
+   */
   void Dijkstra();
+  /**
+   * \brief Repair the shortest path tree for the edges queued by UpdateSpfAdjacency.
+   *
+   * Only the subtrees below changed edges are recomputed, and only their
+   * routing table entries are rewritten.
+   */
+  void IncrementalSpf();
+  /**
+   * \brief Recompute the inter-area summaries this node advertises as an area border router.
+   *
+   * Each area is told about the destinations outside it that the other
+   * areas reach, at this node's cost.  Only intra-area destinations are
+   * summarized into the backbone, so routes never loop back through it.
+   */
+  void UpdateSummaries();
+  /**
+   * \brief Precompute loop-free alternate next hops.
+   *
+   * \param changed Destinations whose routes SPF rewrote; routes whose
+   *        alternate the engines looked at again are added to them, and
+   *        only these get their backup set again.
+   */
+  void ComputeLfas(std::vector<uint32_t> &changed);
+  /**
+   * \brief Request an SPF run, coalescing bursts of LSAs.
+   *
+   * The first change after a quiet period runs after SpfInitialDelay; while
+   * changes keep arriving, runs are spaced by a hold time that doubles up to
+   * SpfMaxWait.
+   */
+  void ScheduleSpf();
+  void RunScheduledSpf();
+
+  /**
+   * \brief Push the changes in m_routingTable into m_staticRouting.
+   *
+   * Host routes are added, replaced or withdrawn only where they differ from
+   * what was installed by the previous call.
+   */
+  void InstallRoutes();
+
+  /**
+   * \brief Rebuild the data-path forwarding table from m_routingTable.
+   */
+  void RebuildFib();
+
+  /**
+   * \returns Number of LSAs handed to ProcessLsp.
+   */
+  uint64_t GetLsaReceivedCount() const;
+
+  /**
+   * \returns Number of SPF computations actually run.
+   */
+  uint64_t GetSpfRunCount() const;
+
+  /**
+   * \returns Processor time spent in SPF computations, in seconds.
+   */
+  double GetSpfCpuSeconds() const;
+
+  /**
+   * \returns Simulation time at which an installed route last changed.
+   */
+  Time GetLastRouteChangeTime() const;
+
+  /**
+   * \returns Number of destinations a route is installed for.
+   */
+  uint32_t GetRouteCount() const;
+
+  /**
+   * \returns Total LS control bytes sent, summed over interfaces.
+   */
+  uint64_t GetControlBytesSent() const;
+
+  /**
+   * \returns LS control bytes sent per second over the last audit period.
+   */
+  double GetControlBytesPerSecond() const;
+
+  /**
+   * \returns Number of times the primary path of an installed route was added, changed or withdrawn.
+   */
+  uint64_t GetRouteChangeCount() const;
+
+  /**
+   * \returns Approximate bytes held by the LSDBs and SPF engines of all areas,
+   * as of the last SPF run.
+   */
+  uint64_t GetLsdbMemoryUsage() const;
+
+  /**
+   * \brief Signature of the "Tx" and "Rx" trace sources.
+   *
+   * \param packet LS control packet, starting with its first LS header
+   * \param messageType LSMessage::MessageType of that header
+   */
+  typedef void (*MessageTracedCallback)(Ptr<const Packet> packet, uint32_t messageType);
+  /**
+   * \brief Signature of the "Spf" trace source.
+   *
+   * \param wallTime Real time the SPF computation took
+   * \param lsas LSAs in the LSDBs it ran over
+   */
+  typedef void (*SpfTracedCallback)(Time wallTime, uint32_t lsas);
+  /**
+   * \brief Signature of the "Flood" trace source.
+   *
+   * \param originator Originator of the flooded LSA
+   * \param fanout Neighbors the LSA was sent to and awaits an ack from
+   */
+  typedef void (*FloodTracedCallback)(Ipv4Address originator, uint32_t fanout);
 
   struct NeighborInfo
   {
@@ -224,6 +497,16 @@ private:
    */
   void BroadcastPacket(Ptr<Packet> packet);
 
+  /**
+   * \brief Send a packet on every LS interface of an area except one.
+   *
+   * \param packet Packet to be sent; consumed by the last send.
+   * \param exclude Local address of the interface to skip (e.g. the ingress
+   *        interface of a flooded LSA), or Ipv4Address::GetAny().
+   * \param area Area whose interfaces to send on, or LS_ALL_AREAS.
+   */
+  void SendOnInterfaces(Ptr<Packet> packet, Ipv4Address exclude, uint32_t area);
+
   /**
    * \brief Returns the main IP address of a node in Inet topology.
    *
@@ -242,14 +525,35 @@ private:
    */
   virtual std::string ReverseLookup(Ipv4Address ipv4Address);
 
+  /**
+   * \brief O(1) address to node number lookup for the control plane.
+   *
+   * \returns false if the address belongs to no known node.
+   */
+  bool LookupNode(Ipv4Address ipv4Address, uint32_t &nodeNumber) const;
+  /**
+   * \returns Node number of this node, or LS_NO_NODE if not known yet.
+   */
+  uint32_t GetSelfNode() const;
+  /**
+   * \returns Area of the interface owning a local address.
+   */
+  uint32_t GetArea(Ipv4Address interfaceAddr) const;
+
   // Status
   void DumpLSA();
   void DumpNeighbors();
   void DumpRoutingTable();
+  void DumpStats();
 
 protected:
   virtual void DoInitialize(void);
   uint32_t GetNextSequenceNumber();
+  /**
+   * \returns Sequence number for our next LSA; LSAs have a 32-bit space of
+   * their own, apart from the wrapping one of the other messages.
+   */
+  uint32_t GetNextLsaSequenceNumber();
 
   typedef std::vector<std::pair<uint32_t, uint32_t>> neighborInfo;
     
@@ -273,29 +577,187 @@ private:
   uint8_t m_maxTTL;
   uint16_t m_lsPort;
   uint32_t m_currentSequenceNumber;
+  uint32_t m_lsaSequenceNumber;
   std::map<uint32_t, Ipv4Address> m_nodeAddressMap;
   std::map<Ipv4Address, uint32_t> m_addressNodeMap;
+  // Hashed/indexed copies of the two maps above, used on every control message
+  std::unordered_map<uint32_t, uint32_t> m_addressNodeTable;
+  std::vector<Ipv4Address> m_nodeAddressTable;
 
   // Timers
-  Timer m_auditPingsTimer;
   Timer m_auditNeighborsTimer;
+  Timer m_spfTimer;
+  Timer m_lsaOriginateTimer;
+  Timer m_lsaRefreshTimer;
+  Timer m_retransmitTimer;
+  Timer m_ackTimer;
+  Timer m_bfdTimer;
+  Timer m_wheelTimer;
+  Timer m_snapshotTimer;
+  Timer m_graceTimer;
+
+  // Graceful restart
+  std::string m_snapshotFile;
+  Time m_snapshotInterval;
+  Time m_gracePeriod;
+  bool m_restarting;                     // routes come from the snapshot until ExitGracefulRestart()
+  std::vector<uint32_t> m_graceNeighbors; // neighbors in the snapshot, awaited before exiting
+
+  // Fast failure detection
+  Time m_bfdInterval;
+  uint32_t m_bfdMultiplier;
+
+  // Shared expiry timers, keyed by (TimerKind << 32 | id)
+  Time m_wheelTick;
+  LSTimerWheel m_timerWheel;
+
+  // Reliable flooding
+  Time m_lsaRetransmitInterval;
+  Time m_lsaAckDelay;
+
+  // LSA origination and aging
+  Time m_lsaMinInterval;
+  Time m_lsaRefreshInterval;
+  Time m_lsaMaxAge;
+  Time m_lastLsaOriginated;
+  bool m_fullLsaDue;
+
+  // Control plane volume
+  void SampleControlRate();
+  uint64_t m_controlTxBytes;
+  uint64_t m_controlRateSampleBytes;
+  Time m_controlRateSampleTime;
+  double m_controlBytesPerSecond;
+
+  // Control plane telemetry
+  struct MessageCounters
+  {
+  uint64_t rxPackets;
+  uint64_t rxBytes;
+  uint64_t txPackets;
+  uint64_t txBytes;
+  };
+  /**
+   * \brief Count a packet against the type of the LS message it starts with.
+   */
+  void CountRx(Ptr<const Packet> packet);
+  void CountTx(Ptr<const Packet> packet);
+  void NoteRouteChange();
+  /**
+   * \brief Refresh the LSDB size and memory trace values.
+   */
+  void UpdateLsdbStats();
+  std::vector<MessageCounters> m_messageCounters; // indexed by LSMessage::MessageType
+  std::vector<uint64_t> m_spfHistogram;           // SPF runs by wall time, bucket i: under 2^i microseconds
+  uint64_t m_floodCount;
+  uint64_t m_floodFanout;
+  uint64_t m_malformedPackets; // dropped from the first message that could not be framed
+  uint64_t m_malformedBytes;
+  TracedCallback<Ptr<const Packet>, uint32_t> m_txTrace;
+  TracedCallback<Ptr<const Packet>, uint32_t> m_rxTrace;
+  TracedCallback<Time, uint32_t> m_spfTrace;
+  TracedCallback<Ipv4Address, uint32_t> m_floodTrace;
+  TracedValue<uint32_t> m_lsdbSize;    // LSAs, all areas
+  TracedValue<uint64_t> m_lsdbMemory;  // bytes
+  TracedValue<uint64_t> m_routeChanges;
+
+  // SPF throttling
+  Time m_spfInitialDelay;
+  Time m_spfHoldTime;
+  Time m_spfMaxWait;
+  Time m_spfHoldCurrent;
+  Time m_lastSpfTime;
+  uint64_t m_lsaReceivedCount;
+  uint64_t m_spfRunCount;
+  double m_spfCpuSeconds;
+  Time m_lastRouteChange;
 
   // Ping tracker
   std::map<uint32_t, Ptr<PingRequest>> m_pingTracker;
 
+  struct RetransmitEntry
+  {
+  uint32_t seqNumber;
+  Ptr<Packet> packet;
+  Time lastSent;
+  };
+
   struct NeighborTableEntry
   {
   //uint32_t nodeNumber;
   Ipv4Address neighborAddr;
   Ipv4Address interfaceAddr;
+  Ipv4Address linkAddr;    // neighbor's address on the shared link
+  uint32_t area;           // area of the interface it was heard on
+  // LSAs flooded to this neighbor and not yet acknowledged, by originator address
+  std::map<uint32_t, RetransmitEntry> retransmit;
+  // LSAs received from this neighbor that still have to be acknowledged
+  LSMessage::lsaKeys pendingAcks;
   Time t_stamp;
-  uint32_t linkwt;
+  Time srtt;               // smoothed HELLO round-trip time
+  uint32_t linkwt;         // cost derived from srtt
+  uint32_t advertisedCost; // cost last put into our LSA
+  Time graceUntil;         // neighbor restarting: keep it up until then
+  bool dbDescSent;         // our LSDB summary went out since the adjacency (re)started
+  bool dbDescHeard;        // and its summary came in
   };
+
+  /**
+   * \brief Fold an RTT sample into a neighbor's smoothed RTT and link cost.
+   *
+   * \returns true if the cost to advertise changed.
+   */
+  bool UpdateLinkCost(NeighborTableEntry &entry, Time rtt);
+
+  /**
+   * \returns The neighbor owning the given (interface) address, or m_neighbors.end().
+   */
+  std::map<uint32_t, NeighborTableEntry>::iterator FindNeighbor(Ipv4Address address);
+  void AcknowledgeLsa(NeighborTableEntry &neighbor, uint32_t originator, uint32_t seqNum);
+  /**
+   * \returns The neighbor's address on the link we share with it, which is
+   * what routes through it need as their gateway.
+   */
+  Ipv4Address GetLinkAddress(const NeighborTableEntry &neighbor) const;
+  void SendToNeighbor(const NeighborTableEntry &neighbor, Ptr<Packet> packet);
+  /**
+   * \brief Send the (originator, sequence) summary of our LSDB to a new neighbor.
+   *
+   * The neighbor answers with an LSA_REQ for the LSAs it lacks or holds
+   * older copies of, and gets them back packed up to the MTU.
+   */
+  void SendDbDesc(NeighborTableEntry &neighbor);
+  /**
+   * \returns Bytes of LS messages that fit in one datagram towards the neighbor.
+   */
+  uint32_t GetMaxPayload(const NeighborTableEntry &neighbor);
+  uint32_t GetMaxPayload(Ipv4Address interfaceAddr);
+  /**
+   * \returns Bytes of LS messages that fit in one datagram on every interface of the area.
+   */
+  uint32_t GetAreaMaxPayload(uint32_t area);
+
+  // HELLO sequence number -> send time, for RTT measurement
+  std::map<uint32_t, Time> m_helloSentTime;
+  Time m_linkCostUnit;
+  double m_rttAlpha;
+  double m_linkCostHysteresis;
   
  struct LSPneighbors{
   Ipv4Address interfaceAd;
+  Ipv4Address originator;
   uint32_t seqNumber;
+  Time installTime;
   std::vector <std::pair<uint32_t, uint32_t>> neighbornodeandCost;
+  // Inter-area destinations advertised by an area border router
+  std::vector<std::pair<uint32_t, uint32_t>> summaries;
+  };
+
+  struct EcmpNextHop
+  {
+  uint32_t nodeNum;
+  Ipv4Address addr;          // neighbor's address on the shared link, the gateway
+  Ipv4Address interfaceAddr;
   };
 
   struct RoutingTableEntry
@@ -305,14 +767,87 @@ private:
   Ipv4Address nextHopAddr;
   Ipv4Address interfaceAddr;
   uint32_t cost;
+  // All equal-cost next hops, the primary one (above) first
+  std::vector<EcmpNextHop> nextHops;
+  uint32_t area; // area whose tree the route comes from
+  // Loop-free alternate, used when every next hop above is lost;
+  // nodeNum is LS_NO_NODE if there is none
+  EcmpNextHop backup;
+  uint32_t backupCost;
   };
 
   std::map<uint32_t, NeighborTableEntry> m_neighbors;
 
-// originator node, sequence number and neighbor info
-  std::map<uint32_t, LSPneighbors> m_validLSP;
+  // Link-state database and shortest path tree of one area this node is in
+  struct AreaState
+  {
+  // originator node, sequence number and neighbor info
+  std::map<uint32_t, LSPneighbors> lsdb;
+  // originator address -> highest LSA sequence number seen, for duplicate suppression
+  std::unordered_map<uint32_t, uint32_t> seenSeq;
+  // Rooted at this node, over the area's links and the summaries in it
+  LSSpfEngine spf;
+  // What we advertise into the area as a border router, sorted by destination
+  neighborInfo summaries;
+  };
+  std::map<uint32_t, AreaState> m_areas;
+  // Ipv4 interface index -> area; interfaces not listed are in the backbone
+  std::map<uint32_t, uint32_t> m_interfaceArea;
+
+  /**
+   * \returns The edges an LSA contributes to the SPF of an area: its links,
+   *          plus its summaries unless we should not route through them.
+   */
+  neighborInfo GetSpfAdjacency(uint32_t area, uint32_t originator, const LSPneighbors &lsp);
 
   std::map<uint32_t, RoutingTableEntry> m_routingTable;
 
+  /**
+   * \returns An LSA_DELTA carrying the adjacencies that differ between base and current.
+   */
+  LSMessage BuildLsaDelta(const LSPneighbors &base, const neighborInfo &current, uint32_t sequenceNumber);
+  /**
+   * \brief Apply a delta in place to an adjacency list sorted by node number.
+   */
+  void ApplyLsaDelta(neighborInfo &adjacency, const LSMessage::LsaDelta &delta);
+  void RequestLsa(const NeighborTableEntry &neighbor, Ipv4Address originator, uint32_t seqNum);
+  /**
+   * \brief Rewrite the routing table entry of a node from the SPF results.
+   *
+   * An intra-area path is preferred over an inter-area one, then the
+   * cheapest, then the one in the lowest area.
+   */
+  void UpdateRoute(uint32_t destNode);
+  /**
+   * \brief Hash of the packet's 5-tuple, used to pick one of several ECMP routes.
+   */
+  uint32_t FlowHash(Ptr<const Packet> packet, const Ipv4Header &header) const;
+
+  // Host routes currently installed in m_staticRouting, by destination node
+  struct InstalledRoute
+  {
+  Ipv4Address destAddr;
+  Ipv4Address nextHopAddr;
+  uint32_t interface;
+  uint32_t metric;
+  // Loop-free alternate, installed with a higher metric; Ipv4Address::GetAny() if none
+  Ipv4Address backupAddr;
+  uint32_t backupInterface;
+  uint32_t backupMetric;
+  };
+  void AddHostRoute(const InstalledRoute &route);
+  void RemoveHostRoute(const InstalledRoute &route);
+  void RemoveStaticRoute(Ipv4Address destAddr, Ipv4Address nextHopAddr, uint32_t interface);
+  std::map<uint32_t, InstalledRoute> m_installedRoutes;
+
+  // Forwarding table consulted by RouteInput/RouteOutput before m_staticRouting
+  LSFib m_fib;
+  // Sorted interface addresses, for IsOwnAddress on the forwarding path
+  std::vector<uint32_t> m_ownAddresses;
+
+  uint32_t m_maxEcmpPaths;
+  uint32_t m_spfThreads;
+  bool m_lfaEnabled;
+
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,1296 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Included by relative path so that the engine also builds outside ns-3.
+#include "ns3/ls-spf-engine.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <queue>
+#include <thread>
+
+const uint32_t LSSpfEngine::INFINITE_COST;
+const uint32_t LSSpfEngine::NO_NODE;
+
+/**
+ * \brief Fixed set of threads that run ParallelFor() loops for the engine.
+ *
+ * An SPF run issues thousands of short loops, so between Start() and
+ * Stop() the workers spin on a generation counter instead of sleeping;
+ * outside of a run they block on a condition variable.
+ */
+class LSSpfWorkers
+{
+public:
+  typedef std::function<void (uint32_t begin, uint32_t end, uint32_t thread)> Body;
+
+  explicit LSSpfWorkers (uint32_t nThreads);
+  ~LSSpfWorkers ();
+
+  uint32_t GetNThreads () const;
+  void Start ();
+  void Stop ();
+
+  /**
+   * \brief Run body over [0, count) in chunks on all threads and wait for it.
+   *
+   * Short ranges run on the calling thread only.  thread is in
+   * [0, GetNThreads ()), the caller being thread 0.
+   */
+  void ParallelFor (uint32_t count, const Body &body);
+
+private:
+  static const uint32_t GRAIN = 256;
+
+  void Work (uint32_t thread);
+  void RunChunks (uint32_t thread);
+
+  std::vector<std::thread> m_threads;
+  std::mutex m_mutex;
+  std::condition_variable m_wake;
+  std::atomic<bool> m_active;
+  std::atomic<bool> m_exit;
+  std::atomic<uint64_t> m_generation;
+  std::atomic<uint64_t> m_next;
+  std::atomic<uint32_t> m_pending;
+  const Body *m_body;
+  uint32_t m_count;
+};
+
+LSSpfWorkers::LSSpfWorkers (uint32_t nThreads)
+  : m_active (false),
+    m_exit (false),
+    m_generation (0),
+    m_next (0),
+    m_pending (0),
+    m_body (0),
+    m_count (0)
+{
+  for (uint32_t i = 1; i < nThreads; i++)
+    {
+      m_threads.push_back (std::thread (&LSSpfWorkers::Work, this, i));
+    }
+}
+
+LSSpfWorkers::~LSSpfWorkers ()
+{
+  {
+    std::lock_guard<std::mutex> lock (m_mutex);
+    m_active = false;
+    m_exit = true;
+  }
+  m_wake.notify_all ();
+  for (uint32_t i = 0; i < m_threads.size (); i++)
+    {
+      m_threads[i].join ();
+    }
+}
+
+uint32_t
+LSSpfWorkers::GetNThreads () const
+{
+  return m_threads.size () + 1;
+}
+
+void
+LSSpfWorkers::Start ()
+{
+  {
+    std::lock_guard<std::mutex> lock (m_mutex);
+    m_active = true;
+  }
+  m_wake.notify_all ();
+}
+
+void
+LSSpfWorkers::Stop ()
+{
+  std::lock_guard<std::mutex> lock (m_mutex);
+  m_active = false;
+}
+
+void
+LSSpfWorkers::Work (uint32_t thread)
+{
+  uint64_t seen = 0;
+  while (true)
+    {
+      {
+        std::unique_lock<std::mutex> lock (m_mutex);
+        m_wake.wait (lock, [this] () { return m_exit || m_active; });
+        if (m_exit)
+          {
+            return;
+          }
+      }
+      while (m_active.load (std::memory_order_acquire))
+        {
+          uint64_t generation = m_generation.load (std::memory_order_acquire);
+          if (generation == seen)
+            {
+              std::this_thread::yield ();
+              continue;
+            }
+          seen = generation;
+          RunChunks (thread);
+          m_pending.fetch_sub (1, std::memory_order_acq_rel);
+        }
+    }
+}
+
+void
+LSSpfWorkers::RunChunks (uint32_t thread)
+{
+  while (true)
+    {
+      uint64_t begin = m_next.fetch_add (GRAIN, std::memory_order_relaxed);
+      if (begin >= m_count)
+        {
+          return;
+        }
+      (*m_body) (begin, std::min<uint64_t> (begin + GRAIN, m_count), thread);
+    }
+}
+
+void
+LSSpfWorkers::ParallelFor (uint32_t count, const Body &body)
+{
+  if (m_threads.empty () || count <= GRAIN)
+    {
+      if (count > 0)
+        {
+          body (0, count, 0);
+        }
+      return;
+    }
+  // Every worker acknowledges every generation, so none can miss one.
+  m_body = &body;
+  m_count = count;
+  m_next.store (0, std::memory_order_relaxed);
+  m_pending.store (m_threads.size (), std::memory_order_relaxed);
+  m_generation.fetch_add (1, std::memory_order_release);
+  RunChunks (0);
+  while (m_pending.load (std::memory_order_acquire) != 0)
+    {
+      std::this_thread::yield ();
+    }
+}
+
+LSSpfEngine::EdgeTable::EdgeTable ()
+  : m_garbage (0),
+    m_lastRow (NO_NODE),
+    m_packed (true)
+{
+}
+
+void
+LSSpfEngine::EdgeTable::Clear ()
+{
+  m_edges.clear ();
+  m_rows.clear ();
+  m_garbage = 0;
+  m_lastRow = NO_NODE;
+  m_packed = true;
+}
+
+void
+LSSpfEngine::EdgeTable::AddRow ()
+{
+  Slice slice = {(uint32_t)m_edges.size (), 0};
+  m_rows.push_back (slice);
+}
+
+void
+LSSpfEngine::EdgeTable::SetRow (uint32_t row, const Edge *begin, const Edge *end)
+{
+  Slice &slice = m_rows[row];
+  uint32_t size = end - begin;
+  if (size <= slice.size)
+    {
+      std::copy (begin, end, m_edges.begin () + slice.start);
+      m_garbage += slice.size - size;
+      m_packed = m_packed && size == slice.size;
+      slice.size = size;
+      return;
+    }
+  if (row == m_lastRow && slice.start + slice.size == m_edges.size ())
+    {
+      // Last slice in the array: grow it where it is.
+      m_edges.resize (slice.start);
+    }
+  else
+    {
+      // Appending keeps the rows in order only if they were, nothing is
+      // left behind and no later row is stored yet.
+      m_garbage += slice.size;
+      m_packed = m_packed && slice.size == 0 && (m_lastRow == NO_NODE || row > m_lastRow);
+      m_lastRow = row;
+      slice.start = m_edges.size ();
+    }
+  slice.size = size;
+  m_edges.insert (m_edges.end (), begin, end);
+  if (m_garbage > m_edges.size () - m_garbage)
+    {
+      Pack ();
+    }
+}
+
+void
+LSSpfEngine::EdgeTable::Pack ()
+{
+  if (m_packed)
+    {
+      return;
+    }
+  std::vector<Edge> edges;
+  edges.reserve (m_edges.size () - m_garbage);
+  m_lastRow = NO_NODE;
+  for (uint32_t row = 0; row < m_rows.size (); row++)
+    {
+      Slice &slice = m_rows[row];
+      uint32_t start = edges.size ();
+      edges.insert (edges.end (), m_edges.begin () + slice.start, m_edges.begin () + slice.start + slice.size);
+      slice.start = start;
+      if (slice.size > 0)
+        {
+          m_lastRow = row;
+        }
+    }
+  m_edges.swap (edges);
+  m_garbage = 0;
+  m_packed = true;
+}
+
+uint64_t
+LSSpfEngine::EdgeTable::GetMemoryUsage () const
+{
+  return m_edges.capacity () * sizeof (Edge) + m_rows.capacity () * sizeof (Slice);
+}
+
+LSSpfEngine::LSSpfEngine ()
+  : m_nEdges (0),
+    m_costSum (0),
+    m_nZeroCost (0),
+    m_workers (0),
+    m_maxPaths (0),
+    m_source (NO_NODE),
+    m_valid (false),
+    m_altSource (NO_NODE),
+    m_altAll (true),
+    m_altVersion (0),
+    m_version (1)
+{
+}
+
+LSSpfEngine::~LSSpfEngine ()
+{
+  delete m_workers;
+}
+
+void
+LSSpfEngine::Clear ()
+{
+  m_index.clear ();
+  m_nodes.clear ();
+  m_outEdges.Clear ();
+  m_inEdges.Clear ();
+  m_cost.clear ();
+  m_parent.clear ();
+  m_nextHops.clear ();
+  m_changes.clear ();
+  m_altNextHop.clear ();
+  m_altCost.clear ();
+  m_altNeighbors.clear ();
+  m_altTrees.clear ();
+  m_altChanges.clear ();
+  m_altDirty.clear ();
+  m_altAll = true;
+  m_altSource = NO_NODE;
+  m_version++;
+  m_nEdges = 0;
+  m_costSum = 0;
+  m_nZeroCost = 0;
+  m_source = NO_NODE;
+  m_valid = false;
+}
+
+void
+LSSpfEngine::SetMaxPaths (uint32_t maxPaths)
+{
+  m_version += m_maxPaths != maxPaths;
+  m_altAll |= m_maxPaths != maxPaths;
+  m_maxPaths = maxPaths;
+}
+
+void
+LSSpfEngine::SetThreads (uint32_t threads)
+{
+  uint32_t current = m_workers ? m_workers->GetNThreads () : 1;
+  if (threads == current)
+    {
+      return;
+    }
+  delete m_workers;
+  m_workers = threads > 1 ? new LSSpfWorkers (threads) : 0;
+}
+
+uint32_t
+LSSpfEngine::GetIndex (uint32_t node)
+{
+  std::unordered_map<uint32_t, uint32_t>::iterator iter = m_index.find (node);
+  if (iter != m_index.end ())
+    {
+      return iter->second;
+    }
+  uint32_t index = m_nodes.size ();
+  m_index.insert (std::make_pair (node, index));
+  m_nodes.push_back (node);
+  m_outEdges.AddRow ();
+  m_inEdges.AddRow ();
+  m_cost.push_back (INFINITE_COST);
+  m_parent.push_back (NO_NODE);
+  m_nextHops.push_back (std::vector<uint32_t> ());
+  return index;
+}
+
+bool
+LSSpfEngine::UpdateAdjacency (uint32_t originator, const Adjacency &adjacency)
+{
+  uint32_t from = GetIndex (originator);
+
+  // Sort and collapse the new list to head -> cheapest cost, so that
+  // reordering or a repeated neighbor in an LSA is not mistaken for a
+  // topology change.  Stored out-edges are kept in the same form.
+  EdgeList wanted;
+  wanted.reserve (adjacency.size ());
+  for (uint32_t i = 0; i < adjacency.size (); i++)
+    {
+      wanted.push_back (std::make_pair (GetIndex (adjacency[i].first), adjacency[i].second));
+    }
+  std::sort (wanted.begin (), wanted.end ());
+  uint32_t kept = 0;
+  for (uint32_t i = 0; i < wanted.size (); i++)
+    {
+      if (kept == 0 || wanted[kept - 1].first != wanted[i].first)
+        {
+          wanted[kept++] = wanted[i];
+        }
+    }
+  wanted.resize (kept);
+
+  const EdgeTable::Row current = m_outEdges[from];
+  bool changed = false;
+  EdgeList inEdges;
+  const Edge *o = current.begin ();
+  EdgeList::const_iterator n = wanted.begin ();
+  while (o != current.end () || n != wanted.end ())
+    {
+      EdgeChange change;
+      change.from = from;
+      if (n == wanted.end () || (o != current.end () && o->first < n->first))
+        {
+          change.to = o->first;
+          change.oldCost = o->second;
+          change.newCost = INFINITE_COST;
+          o++;
+        }
+      else if (o == current.end () || n->first < o->first)
+        {
+          change.to = n->first;
+          change.oldCost = INFINITE_COST;
+          change.newCost = n->second;
+          n++;
+        }
+      else
+        {
+          change.to = n->first;
+          change.oldCost = o->second;
+          change.newCost = n->second;
+          o++;
+          n++;
+          if (change.oldCost == change.newCost)
+            {
+              continue;
+            }
+        }
+
+      // Keep the reverse adjacency in step; the incremental repair uses it
+      // to find a new parent for nodes cut off from the tree.
+      const EdgeTable::Row oldInEdges = m_inEdges[change.to];
+      inEdges.assign (oldInEdges.begin (), oldInEdges.end ());
+      for (uint32_t i = 0; i < inEdges.size (); i++)
+        {
+          if (inEdges[i].first == from)
+            {
+              inEdges.erase (inEdges.begin () + i);
+              break;
+            }
+        }
+      if (change.newCost != INFINITE_COST)
+        {
+          inEdges.push_back (std::make_pair (from, change.newCost));
+        }
+      m_inEdges.SetRow (change.to, inEdges.data (), inEdges.data () + inEdges.size ());
+      m_changes.push_back (change);
+      changed = true;
+    }
+
+  if (changed)
+    {
+      for (uint32_t i = 0; i < current.size (); i++)
+        {
+          m_costSum -= current[i].second;
+          m_nZeroCost -= current[i].second == 0;
+        }
+      for (uint32_t i = 0; i < wanted.size (); i++)
+        {
+          m_costSum += wanted[i].second;
+          m_nZeroCost += wanted[i].second == 0;
+        }
+      m_nEdges += wanted.size ();
+      m_nEdges -= current.size ();
+      m_outEdges.SetRow (from, wanted.data (), wanted.data () + wanted.size ());
+      m_version++;
+    }
+  return changed;
+}
+
+void
+LSSpfEngine::ComputeFull (uint32_t source, std::vector<uint32_t> &changed)
+{
+  uint32_t numNodes = m_nodes.size ();
+  if (!m_altTrees.empty ())
+    {
+      m_altChanges.insert (m_altChanges.end (), m_changes.begin (), m_changes.end ());
+    }
+  m_altAll = true;
+  m_altDirty.clear ();
+  m_changes.clear ();
+  m_outEdges.Pack ();
+  m_inEdges.Pack ();
+  std::unordered_map<uint32_t, uint32_t>::const_iterator self = m_index.find (source);
+  m_valid = self != m_index.end ();
+  if (m_valid)
+    {
+      m_source = self->second;
+      if (m_workers && m_nZeroCost == 0)
+        {
+          ComputeFullParallel (changed);
+          return;
+        }
+    }
+  m_cost.assign (numNodes, INFINITE_COST);
+  m_parent.assign (numNodes, NO_NODE);
+  m_nextHops.assign (numNodes, std::vector<uint32_t> ());
+  if (!m_valid)
+    {
+      return;
+    }
+
+  std::vector<bool> visited (numNodes, false);
+  std::vector<uint32_t> settled;
+  settled.reserve (numNodes);
+  // Stale entries are skipped when popped instead of being decreased in place.
+  std::priority_queue<HeapEntry, std::vector<HeapEntry>, std::greater<HeapEntry>> tentative;
+  m_cost[m_source] = 0;
+  tentative.push (std::make_pair (0, m_source));
+
+  while (!tentative.empty ())
+    {
+      uint32_t node = tentative.top ().second;
+      tentative.pop ();
+      if (visited[node])
+        {
+          continue;
+        }
+      visited[node] = true;
+      settled.push_back (node);
+      const EdgeTable::Row outEdges = m_outEdges[node];
+      for (uint32_t i = 0; i < outEdges.size (); i++)
+        {
+          uint32_t neighbor = outEdges[i].first;
+          uint32_t newCost = m_cost[node] + outEdges[i].second;
+          if (visited[neighbor] || newCost > m_cost[neighbor])
+            {
+              continue;
+            }
+          if (newCost == m_cost[neighbor])
+            {
+              // Settle ties on the lowest index, as the parallel run does.
+              m_parent[neighbor] = std::min (m_parent[neighbor], node);
+              continue;
+            }
+          m_cost[neighbor] = newCost;
+          m_parent[neighbor] = node;
+          tentative.push (std::make_pair (newCost, neighbor));
+        }
+    }
+
+  // Nodes settle in cost order, so all equal-cost predecessors of a node
+  // already have their first hops when it is reached here.
+  for (uint32_t i = 0; i < settled.size (); i++)
+    {
+      ComputeNextHops (settled[i]);
+    }
+  changed.insert (changed.end (), m_nodes.begin (), m_nodes.end ());
+}
+
+void
+LSSpfEngine::ComputeFullParallel (std::vector<uint32_t> &changed)
+{
+  // Delta-stepping: tentative costs are kept in buckets of width delta.
+  // The lowest bucket is emptied in rounds that relax only the light
+  // edges (cost <= delta) of its nodes, in parallel, until no node falls
+  // into it any more; its nodes are then final and relax their heavy edges
+  // once.  Buckets live on a ring, per thread so that relaxations need no
+  // locks; costs beyond the ring wait on an overflow list.
+  static const uint32_t RING = 1024;
+  struct ThreadState
+  {
+    std::vector<uint32_t> ring[RING];
+    std::vector<uint32_t> overflow;
+    std::vector<uint32_t> settled;
+    uint64_t nRing;
+  };
+
+  uint32_t numNodes = m_nodes.size ();
+  uint32_t nThreads = m_workers->GetNThreads ();
+  uint64_t delta = std::max<uint64_t> (1, m_costSum / std::max<uint64_t> (1, m_nEdges));
+  std::vector<ThreadState> state (nThreads);
+  std::vector<std::atomic<uint32_t>> cost (numNodes);
+  std::vector<std::atomic<uint32_t>> lightDone (numNodes); //!< Cost at which light edges were relaxed
+  std::vector<std::atomic<bool>> inBucket (numNodes);
+  uint64_t current = 0;
+
+  m_workers->Start ();
+  m_workers->ParallelFor (numNodes, [&] (uint32_t begin, uint32_t end, uint32_t) {
+    for (uint32_t i = begin; i < end; i++)
+      {
+        cost[i].store (INFINITE_COST, std::memory_order_relaxed);
+        lightDone[i].store (INFINITE_COST, std::memory_order_relaxed);
+        inBucket[i].store (false, std::memory_order_relaxed);
+      }
+  });
+
+  auto relax = [&] (uint32_t thread, uint32_t node, uint32_t newCost) {
+    uint32_t old = cost[node].load (std::memory_order_relaxed);
+    while (newCost < old)
+      {
+        if (cost[node].compare_exchange_weak (old, newCost, std::memory_order_relaxed))
+          {
+            ThreadState &own = state[thread];
+            uint64_t bucket = newCost / delta;
+            if (bucket - current < RING)
+              {
+                own.ring[bucket % RING].push_back (node);
+                own.nRing++;
+              }
+            else
+              {
+                own.overflow.push_back (node);
+              }
+            return;
+          }
+      }
+  };
+
+  cost[m_source] = 0;
+  state[0].ring[0].push_back (m_source);
+  state[0].nRing = 1;
+  std::vector<uint32_t> frontier;
+  std::vector<uint32_t> bucketNodes;
+  std::vector<uint32_t> order; // reachable nodes in cost order
+  order.reserve (numNodes);
+  while (true)
+    {
+      uint64_t nRing = 0;
+      for (uint32_t t = 0; t < nThreads; t++)
+        {
+          nRing += state[t].nRing;
+        }
+      if (nRing == 0)
+        {
+          // Ring exhausted: jump to the lowest overflow bucket and refile.
+          // Entries of nodes that got cheaper and were settled since are dropped.
+          frontier.clear ();
+          for (uint32_t t = 0; t < nThreads; t++)
+            {
+              std::vector<uint32_t> &overflow = state[t].overflow;
+              for (uint32_t i = 0; i < overflow.size (); i++)
+                {
+                  if (lightDone[overflow[i]] != cost[overflow[i]])
+                    {
+                      frontier.push_back (overflow[i]);
+                    }
+                }
+              overflow.clear ();
+            }
+          if (frontier.empty ())
+            {
+              break;
+            }
+          current = std::numeric_limits<uint64_t>::max ();
+          for (uint32_t i = 0; i < frontier.size (); i++)
+            {
+              current = std::min<uint64_t> (current, cost[frontier[i]] / delta);
+            }
+          for (uint32_t i = 0; i < frontier.size (); i++)
+            {
+              uint64_t bucket = cost[frontier[i]] / delta;
+              if (bucket - current < RING)
+                {
+                  state[0].ring[bucket % RING].push_back (frontier[i]);
+                  state[0].nRing++;
+                }
+              else
+                {
+                  state[0].overflow.push_back (frontier[i]);
+                }
+            }
+          continue;
+        }
+
+      // Light edges, until the bucket stays empty.
+      uint32_t slot = current % RING;
+      while (true)
+        {
+          frontier.clear ();
+          for (uint32_t t = 0; t < nThreads; t++)
+            {
+              std::vector<uint32_t> &entries = state[t].ring[slot];
+              frontier.insert (frontier.end (), entries.begin (), entries.end ());
+              state[t].nRing -= entries.size ();
+              entries.clear ();
+            }
+          if (frontier.empty ())
+            {
+              break;
+            }
+          m_workers->ParallelFor (frontier.size (), [&] (uint32_t begin, uint32_t end, uint32_t thread) {
+            for (uint32_t i = begin; i < end; i++)
+              {
+                uint32_t node = frontier[i];
+                uint32_t nodeCost = cost[node].load (std::memory_order_relaxed);
+                if (nodeCost / delta != current ||
+                    lightDone[node].exchange (nodeCost, std::memory_order_relaxed) == nodeCost)
+                  {
+                    continue; // stale, or already relaxed at this cost
+                  }
+                if (!inBucket[node].exchange (true, std::memory_order_relaxed))
+                  {
+                    state[thread].settled.push_back (node);
+                  }
+                const EdgeTable::Row outEdges = m_outEdges[node];
+                for (uint32_t j = 0; j < outEdges.size (); j++)
+                  {
+                    if (outEdges[j].second <= delta)
+                      {
+                        relax (thread, outEdges[j].first, nodeCost + outEdges[j].second);
+                      }
+                  }
+              }
+          });
+        }
+
+      // Heavy edges, once per node of the now final bucket.
+      bucketNodes.clear ();
+      for (uint32_t t = 0; t < nThreads; t++)
+        {
+          bucketNodes.insert (bucketNodes.end (), state[t].settled.begin (), state[t].settled.end ());
+          state[t].settled.clear ();
+        }
+      m_workers->ParallelFor (bucketNodes.size (), [&] (uint32_t begin, uint32_t end, uint32_t thread) {
+        for (uint32_t i = begin; i < end; i++)
+          {
+            uint32_t node = bucketNodes[i];
+            uint32_t nodeCost = cost[node].load (std::memory_order_relaxed);
+            inBucket[node].store (false, std::memory_order_relaxed);
+            const EdgeTable::Row outEdges = m_outEdges[node];
+            for (uint32_t j = 0; j < outEdges.size (); j++)
+              {
+                if (outEdges[j].second > delta)
+                  {
+                    relax (thread, outEdges[j].first, nodeCost + outEdges[j].second);
+                  }
+              }
+          }
+      });
+      std::sort (bucketNodes.begin (), bucketNodes.end (), [&] (uint32_t a, uint32_t b) {
+        uint32_t costA = cost[a].load (std::memory_order_relaxed);
+        uint32_t costB = cost[b].load (std::memory_order_relaxed);
+        return costA < costB || (costA == costB && a < b);
+      });
+      order.insert (order.end (), bucketNodes.begin (), bucketNodes.end ());
+      current++;
+    }
+
+  // Parents: the lowest-index predecessor on a shortest path, as in the
+  // serial run.  The cheapest edge bounds how close in cost a node and its
+  // predecessors can be, which the first hop pass below relies on.
+  std::vector<uint32_t> minCost (nThreads, INFINITE_COST);
+  m_nextHops.resize (numNodes);
+  m_workers->ParallelFor (numNodes, [&] (uint32_t begin, uint32_t end, uint32_t thread) {
+    for (uint32_t node = begin; node < end; node++)
+      {
+        uint32_t nodeCost = cost[node].load (std::memory_order_relaxed);
+        m_cost[node] = nodeCost;
+        m_parent[node] = NO_NODE;
+        std::vector<uint32_t> ().swap (m_nextHops[node]);
+        const EdgeTable::Row inEdges = m_inEdges[node];
+        for (uint32_t i = 0; i < inEdges.size (); i++)
+          {
+            minCost[thread] = std::min (minCost[thread], inEdges[i].second);
+            uint32_t pred = inEdges[i].first;
+            uint32_t predCost = cost[pred].load (std::memory_order_relaxed);
+            if (node != m_source && predCost != INFINITE_COST && predCost + inEdges[i].second == nodeCost)
+              {
+                m_parent[node] = std::min (m_parent[node], pred);
+              }
+          }
+      }
+  });
+  uint64_t window = *std::min_element (minCost.begin (), minCost.end ());
+
+  // First hops only depend on predecessors, which are at least window
+  // cheaper, so every cost range [c, c + window) can be done in parallel.
+  for (uint32_t first = 0; first < order.size ();)
+    {
+      uint64_t limit = (uint64_t)m_cost[order[first]] + window;
+      uint32_t last = first;
+      while (last < order.size () && m_cost[order[last]] < limit)
+        {
+          last++;
+        }
+      m_workers->ParallelFor (last - first, [&] (uint32_t begin, uint32_t end, uint32_t) {
+        for (uint32_t i = begin; i < end; i++)
+          {
+            ComputeNextHops (order[first + i]);
+          }
+      });
+      first = last;
+    }
+  m_workers->Stop ();
+  changed.insert (changed.end (), m_nodes.begin (), m_nodes.end ());
+}
+
+bool
+LSSpfEngine::Compute (uint32_t source, std::vector<uint32_t> &changed)
+{
+  std::unordered_map<uint32_t, uint32_t>::const_iterator self = m_index.find (source);
+  if (!m_valid || self == m_index.end () || self->second != m_source)
+    {
+      ComputeFull (source, changed);
+      return true;
+    }
+
+  MergeChanges (m_changes);
+  uint32_t numNodes = m_nodes.size ();
+  // Repairs run on one thread; past this share of changed edges a parallel
+  // rebuild is the cheaper way to the same tree.
+  static const uint32_t REBUILD_FRACTION = 16;
+  if (m_workers && m_nZeroCost == 0 && !m_changes.empty () && m_changes.size () * REBUILD_FRACTION >= numNodes)
+    {
+      ComputeFull (source, changed);
+      return true;
+    }
+  std::vector<uint32_t> touched;
+  RepairTree (m_changes, m_cost, m_parent, touched);
+  if (!m_altTrees.empty ())
+    {
+      m_altChanges.insert (m_altChanges.end (), m_changes.begin (), m_changes.end ());
+    }
+  if (m_altDirty.size () > numNodes)
+    {
+      // Cheaper to look at everything than to keep the list growing.
+      m_altDirty.clear ();
+      m_altAll = true;
+    }
+  m_changes.clear ();
+
+  // 5. Refresh first hops in cost order.  A node whose cost or first hops
+  //    changed passes that on to its successors, so the refresh spreads
+  //    downwards only as far as something actually changed.
+  std::priority_queue<HeapEntry, std::vector<HeapEntry>, std::greater<HeapEntry>> refresh;
+  std::vector<bool> costChanged (numNodes, false);
+  for (uint32_t i = 0; i < touched.size (); i++)
+    {
+      costChanged[touched[i]] = true;
+      refresh.push (std::make_pair (m_cost[touched[i]], touched[i]));
+    }
+  HeapEntry last (INFINITE_COST, NO_NODE);
+  while (!refresh.empty ())
+    {
+      HeapEntry top = refresh.top ();
+      refresh.pop ();
+      if (top == last)
+        {
+          continue;
+        }
+      last = top;
+      uint32_t node = top.second;
+      if (!ComputeNextHops (node) && !costChanged[node])
+        {
+          continue;
+        }
+      costChanged[node] = false;
+      changed.push_back (m_nodes[node]);
+      if (!m_altTrees.empty ())
+        {
+          m_altDirty.push_back (node);
+        }
+      const EdgeTable::Row outEdges = m_outEdges[node];
+      for (uint32_t i = 0; i < outEdges.size (); i++)
+        {
+          uint32_t successor = outEdges[i].first;
+          if (m_cost[successor] != INFINITE_COST)
+            {
+              refresh.push (std::make_pair (m_cost[successor], successor));
+            }
+        }
+    }
+  return false;
+}
+
+void
+LSSpfEngine::RepairTree (const std::vector<EdgeChange> &changes, std::vector<uint32_t> &cost,
+                         std::vector<uint32_t> &parent, std::vector<uint32_t> &touched) const
+{
+  uint32_t numNodes = m_nodes.size ();
+  std::priority_queue<HeapEntry, std::vector<HeapEntry>, std::greater<HeapEntry>> tentative;
+  std::vector<bool> detached (numNodes, false);
+
+  // 1. A tree edge that got worse (or vanished) detaches the whole subtree
+  //    below it.  Walk it through the parent pointers and forget its costs.
+  std::vector<uint32_t> subtree;
+  for (uint32_t i = 0; i < changes.size (); i++)
+    {
+      const EdgeChange &change = changes[i];
+      if (change.newCost > change.oldCost && parent[change.to] == change.from && !detached[change.to])
+        {
+          detached[change.to] = true;
+          subtree.push_back (change.to);
+        }
+    }
+  for (uint32_t i = 0; i < subtree.size (); i++)
+    {
+      const EdgeTable::Row outEdges = m_outEdges[subtree[i]];
+      for (uint32_t j = 0; j < outEdges.size (); j++)
+        {
+          uint32_t child = outEdges[j].first;
+          if (!detached[child] && parent[child] == subtree[i])
+            {
+              detached[child] = true;
+              subtree.push_back (child);
+            }
+        }
+    }
+  for (uint32_t i = 0; i < subtree.size (); i++)
+    {
+      cost[subtree[i]] = INFINITE_COST;
+      parent[subtree[i]] = NO_NODE;
+      touched.push_back (subtree[i]);
+    }
+
+  // 2. Reattach every detached node through its best intact predecessor.
+  for (uint32_t i = 0; i < subtree.size (); i++)
+    {
+      uint32_t node = subtree[i];
+      const EdgeTable::Row inEdges = m_inEdges[node];
+      for (uint32_t j = 0; j < inEdges.size (); j++)
+        {
+          uint32_t pred = inEdges[j].first;
+          if (detached[pred] || cost[pred] == INFINITE_COST)
+            {
+              continue;
+            }
+          uint32_t newCost = cost[pred] + inEdges[j].second;
+          if (newCost < cost[node])
+            {
+              cost[node] = newCost;
+              parent[node] = pred;
+            }
+        }
+      if (cost[node] != INFINITE_COST)
+        {
+          tentative.push (std::make_pair (cost[node], node));
+        }
+    }
+
+  // Heads of changed edges keep their cost but may gain or lose an
+  // equal-cost path, so their first hops have to be recomputed as well.
+  for (uint32_t i = 0; i < changes.size (); i++)
+    {
+      touched.push_back (changes[i].to);
+    }
+
+  // 3. Edges that got cheaper (or appeared) can only pull nodes closer.
+  for (uint32_t i = 0; i < changes.size (); i++)
+    {
+      const EdgeChange &change = changes[i];
+      if (change.newCost >= change.oldCost || cost[change.from] == INFINITE_COST)
+        {
+          continue;
+        }
+      uint32_t newCost = cost[change.from] + change.newCost;
+      if (newCost < cost[change.to])
+        {
+          cost[change.to] = newCost;
+          parent[change.to] = change.from;
+          tentative.push (std::make_pair (newCost, change.to));
+        }
+    }
+
+  // 4. Ordinary Dijkstra, but seeded only with the nodes whose cost moved.
+  while (!tentative.empty ())
+    {
+      HeapEntry top = tentative.top ();
+      tentative.pop ();
+      uint32_t node = top.second;
+      if (top.first != cost[node])
+        {
+          continue;
+        }
+      touched.push_back (node);
+      const EdgeTable::Row outEdges = m_outEdges[node];
+      for (uint32_t i = 0; i < outEdges.size (); i++)
+        {
+          uint32_t neighbor = outEdges[i].first;
+          uint32_t newCost = cost[node] + outEdges[i].second;
+          if (newCost < cost[neighbor])
+            {
+              cost[neighbor] = newCost;
+              parent[neighbor] = node;
+              tentative.push (std::make_pair (newCost, neighbor));
+            }
+        }
+    }
+}
+
+void
+LSSpfEngine::MergeChanges (std::vector<EdgeChange> &changes)
+{
+  // An originator updated twice since the last run queues a change per
+  // update; an edge added and then removed again must not seed step 3 of
+  // RepairTree() with a cost it no longer has.  The net change keeps the cost
+  // the tree was built with and the cost the edge has now.
+  std::stable_sort (changes.begin (), changes.end (), [] (const EdgeChange &a, const EdgeChange &b) {
+    return a.from < b.from || (a.from == b.from && a.to < b.to);
+  });
+  uint32_t kept = 0;
+  for (uint32_t i = 0; i < changes.size (); i++)
+    {
+      if (kept > 0 && changes[kept - 1].from == changes[i].from && changes[kept - 1].to == changes[i].to)
+        {
+          changes[kept - 1].newCost = changes[i].newCost;
+          continue;
+        }
+      if (kept > 0 && changes[kept - 1].oldCost == changes[kept - 1].newCost)
+        {
+          kept--;
+        }
+      changes[kept++] = changes[i];
+    }
+  if (kept > 0 && changes[kept - 1].oldCost == changes[kept - 1].newCost)
+    {
+      kept--;
+    }
+  changes.resize (kept);
+}
+
+bool
+LSSpfEngine::ComputeNextHops (uint32_t index)
+{
+  // The first hops of a node are the union of those of every predecessor on
+  // an equal-cost shortest path; a neighbor of the source is its own first hop.
+  std::vector<uint32_t> nextHops;
+  if (index != m_source && m_cost[index] != INFINITE_COST)
+    {
+      const EdgeTable::Row inEdges = m_inEdges[index];
+      for (uint32_t i = 0; i < inEdges.size (); i++)
+        {
+          uint32_t pred = inEdges[i].first;
+          if (m_cost[pred] == INFINITE_COST || m_cost[pred] + inEdges[i].second != m_cost[index])
+            {
+              continue;
+            }
+          if (pred == m_source)
+            {
+              nextHops.push_back (m_nodes[index]);
+            }
+          else
+            {
+              nextHops.insert (nextHops.end (), m_nextHops[pred].begin (), m_nextHops[pred].end ());
+            }
+        }
+      std::sort (nextHops.begin (), nextHops.end ());
+      nextHops.erase (std::unique (nextHops.begin (), nextHops.end ()), nextHops.end ());
+      if (m_maxPaths > 0 && nextHops.size () > m_maxPaths)
+        {
+          nextHops.resize (m_maxPaths);
+        }
+    }
+  if (nextHops == m_nextHops[index])
+    {
+      return false;
+    }
+  m_nextHops[index].swap (nextHops);
+  return true;
+}
+
+uint32_t
+LSSpfEngine::GetCost (uint32_t node) const
+{
+  std::unordered_map<uint32_t, uint32_t>::const_iterator iter = m_index.find (node);
+  if (!m_valid || iter == m_index.end () || iter->second >= m_cost.size ())
+    {
+      return INFINITE_COST;
+    }
+  return m_cost[iter->second];
+}
+
+const std::vector<uint32_t> &
+LSSpfEngine::GetNextHops (uint32_t node) const
+{
+  static const std::vector<uint32_t> none;
+  std::unordered_map<uint32_t, uint32_t>::const_iterator iter = m_index.find (node);
+  if (!m_valid || iter == m_index.end () || iter->second >= m_nextHops.size ())
+    {
+      return none;
+    }
+  return m_nextHops[iter->second];
+}
+
+void
+LSSpfEngine::ComputeTreeFrom (uint32_t root, std::vector<uint32_t> &cost, std::vector<uint32_t> &parent) const
+{
+  cost.assign (m_nodes.size (), INFINITE_COST);
+  parent.assign (m_nodes.size (), NO_NODE);
+  std::priority_queue<HeapEntry, std::vector<HeapEntry>, std::greater<HeapEntry>> tentative;
+  cost[root] = 0;
+  tentative.push (std::make_pair (0, root));
+  while (!tentative.empty ())
+    {
+      uint32_t nodeCost = tentative.top ().first;
+      uint32_t node = tentative.top ().second;
+      tentative.pop ();
+      if (nodeCost != cost[node])
+        {
+          continue;
+        }
+      const EdgeTable::Row outEdges = m_outEdges[node];
+      for (uint32_t i = 0; i < outEdges.size (); i++)
+        {
+          uint32_t newCost = nodeCost + outEdges[i].second;
+          if (newCost < cost[outEdges[i].first])
+            {
+              cost[outEdges[i].first] = newCost;
+              parent[outEdges[i].first] = node;
+              tentative.push (std::make_pair (newCost, outEdges[i].first));
+            }
+        }
+    }
+}
+
+void
+LSSpfEngine::ComputeAlternates (const std::vector<uint32_t> &neighbors, std::vector<uint32_t> &changed)
+{
+  uint32_t numNodes = m_nodes.size ();
+  if (m_valid && m_altVersion == m_version && m_altSource == m_source
+      && m_altNeighbors == neighbors && m_altNextHop.size () == numNodes)
+    {
+      // Neither the tree nor the candidates moved; the last result stands.
+      return;
+    }
+  bool all = m_altAll || m_altSource != m_source || m_altNeighbors != neighbors
+             || m_altNextHop.size () != numNodes;
+  m_altNeighbors = neighbors;
+  m_altSource = m_source;
+  m_altVersion = m_version;
+  m_altAll = false;
+  if (!m_valid)
+    {
+      m_altNextHop.assign (numNodes, NO_NODE);
+      m_altCost.assign (numNodes, INFINITE_COST);
+      m_altDirty.clear ();
+      m_altAll = true;
+      changed.insert (changed.end (), m_nodes.begin (), m_nodes.end ());
+      return;
+    }
+
+  // Bring the trees of the last call up to date with the edge changes
+  // since, the same way Compute() repairs the main tree.  Destinations
+  // whose cost from some neighbor may have moved join those whose primary
+  // path changed.
+  m_outEdges.Pack ();
+  m_inEdges.Pack ();
+  MergeChanges (m_altChanges);
+  for (uint32_t t = 0; t < m_altTrees.size (); t++)
+    {
+      m_altTrees[t].cost.resize (numNodes, INFINITE_COST);
+      m_altTrees[t].parent.resize (numNodes, NO_NODE);
+      if (!m_altChanges.empty ())
+        {
+          RepairTree (m_altChanges, m_altTrees[t].cost, m_altTrees[t].parent, m_altDirty);
+        }
+    }
+  m_altChanges.clear ();
+
+  std::vector<AltTree> trees;
+  const EdgeTable::Row links = m_outEdges[m_source];
+  for (uint32_t n = 0; n < neighbors.size (); n++)
+    {
+      std::unordered_map<uint32_t, uint32_t>::const_iterator iter = m_index.find (neighbors[n]);
+      if (iter == m_index.end ())
+        {
+          continue;
+        }
+      const Edge *link =
+        std::lower_bound (links.begin (), links.end (), std::make_pair (iter->second, (uint32_t)0));
+      if (link == links.end () || link->first != iter->second)
+        {
+          continue;
+        }
+
+      // A neighbor kept from the last call takes its repaired tree; only a
+      // new one costs a full Dijkstra run.
+      trees.push_back (AltTree ());
+      AltTree &tree = trees.back ();
+      tree.root = iter->second;
+      tree.node = neighbors[n];
+      tree.linkCost = link->second;
+      for (uint32_t t = 0; t < m_altTrees.size (); t++)
+        {
+          if (m_altTrees[t].root == tree.root && !m_altTrees[t].cost.empty ())
+            {
+              tree.cost.swap (m_altTrees[t].cost);
+              tree.parent.swap (m_altTrees[t].parent);
+              all |= m_altTrees[t].linkCost != tree.linkCost || m_altTrees[t].backToSource != tree.cost[m_source];
+              break;
+            }
+        }
+      if (tree.cost.size () != numNodes)
+        {
+          ComputeTreeFrom (tree.root, tree.cost, tree.parent);
+          all = true;
+        }
+      tree.backToSource = tree.cost[m_source];
+    }
+  m_altTrees.swap (trees);
+
+  // A neighbor whose link or way back changed moves the loop-free test of
+  // every destination; otherwise only the marked ones are looked at again.
+  if (all)
+    {
+      m_altNextHop.assign (numNodes, NO_NODE);
+      m_altCost.assign (numNodes, INFINITE_COST);
+      for (uint32_t i = 0; i < numNodes; i++)
+        {
+          SelectAlternate (i);
+        }
+      changed.insert (changed.end (), m_nodes.begin (), m_nodes.end ());
+    }
+  else
+    {
+      std::sort (m_altDirty.begin (), m_altDirty.end ());
+      m_altDirty.erase (std::unique (m_altDirty.begin (), m_altDirty.end ()), m_altDirty.end ());
+      for (uint32_t i = 0; i < m_altDirty.size (); i++)
+        {
+          SelectAlternate (m_altDirty[i]);
+          changed.push_back (m_nodes[m_altDirty[i]]);
+        }
+    }
+  m_altDirty.clear ();
+}
+
+void
+LSSpfEngine::SelectAlternate (uint32_t index)
+{
+  m_altNextHop[index] = NO_NODE;
+  m_altCost[index] = INFINITE_COST;
+  if (index == m_source || m_cost[index] == INFINITE_COST)
+    {
+      return;
+    }
+  const std::vector<uint32_t> &primary = m_nextHops[index];
+  for (uint32_t t = 0; t < m_altTrees.size (); t++)
+    {
+      const AltTree &tree = m_altTrees[t];
+      uint32_t fromNeighbor = tree.cost[index];
+      if (fromNeighbor == INFINITE_COST || fromNeighbor >= (uint64_t)tree.backToSource + m_cost[index]
+          || std::binary_search (primary.begin (), primary.end (), tree.node))
+        {
+          continue;
+        }
+      uint64_t cost = (uint64_t)tree.linkCost + fromNeighbor;
+      if (cost < m_altCost[index] || (cost == m_altCost[index] && tree.node < m_altNextHop[index]))
+        {
+          m_altNextHop[index] = tree.node;
+          m_altCost[index] = (uint32_t)std::min<uint64_t> (cost, INFINITE_COST - 1);
+        }
+    }
+}
+
+uint32_t
+LSSpfEngine::GetAlternate (uint32_t node, uint32_t &cost) const
+{
+  std::unordered_map<uint32_t, uint32_t>::const_iterator iter = m_index.find (node);
+  if (!m_valid || iter == m_index.end () || iter->second >= m_altNextHop.size ())
+    {
+      cost = INFINITE_COST;
+      return NO_NODE;
+    }
+  cost = m_altCost[iter->second];
+  return m_altNextHop[iter->second];
+}
+
+uint32_t
+LSSpfEngine::GetNNodes () const
+{
+  return m_nodes.size ();
+}
+
+uint64_t
+LSSpfEngine::GetNEdges () const
+{
+  return m_nEdges;
+}
+
+uint64_t
+LSSpfEngine::GetMemoryUsage () const
+{
+  // One hash node (key, value, next pointer) per entry plus the bucket array
+  uint64_t bytes = m_index.size () * (sizeof (std::pair<uint32_t, uint32_t>) + sizeof (void *))
+                   + m_index.bucket_count () * sizeof (void *);
+  bytes += (m_nodes.capacity () + m_cost.capacity () + m_parent.capacity ()
+            + m_altNextHop.capacity () + m_altCost.capacity ()) * sizeof (uint32_t);
+  bytes += m_nextHops.capacity () * sizeof (std::vector<uint32_t>);
+  for (uint32_t i = 0; i < m_nextHops.size (); i++)
+    {
+      bytes += m_nextHops[i].capacity () * sizeof (uint32_t);
+    }
+  bytes += (m_changes.capacity () + m_altChanges.capacity ()) * sizeof (EdgeChange);
+  bytes += m_altDirty.capacity () * sizeof (uint32_t);
+  for (uint32_t i = 0; i < m_altTrees.size (); i++)
+    {
+      bytes += (m_altTrees[i].cost.capacity () + m_altTrees[i].parent.capacity ()) * sizeof (uint32_t);
+    }
+  bytes += m_outEdges.GetMemoryUsage () + m_inEdges.GetMemoryUsage ();
+  return bytes;
+}
@@ -0,0 +1,319 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef LS_SPF_ENGINE_H
+#define LS_SPF_ENGINE_H
+
+#include <stdint.h>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class LSSpfWorkers;
+
+/**
+ * \brief Link-state database and shortest path tree, on plain node numbers.
+ *
+ * The engine holds the directed adjacency advertised by every originator
+ * and the shortest path tree rooted at one source, with up to MaxPaths
+ * equal-cost first hops per destination.  It has no ns-3 dependencies so
+ * that it can be benchmarked and tested on its own; LSRoutingProtocol
+ * feeds it LSAs and turns its output into routes.
+ *
+ * Adjacency changes are queued by UpdateAdjacency() and applied to the
+ * tree by the next Compute(), which repairs only the subtrees below the
+ * changed edges.  The adjacency itself is kept in compressed sparse row
+ * form (see EdgeTable), so SPF reads it from one contiguous array.
+ *
+ * Full runs can be spread over several threads (SetThreads()), using
+ * delta-stepping instead of Dijkstra.  Ties between equal-cost parents
+ * are broken towards the lowest node index in both, so the two produce
+ * the same tree.  With threads, Compute() also rebuilds instead of
+ * repairing when many edges changed at once.
+ *
+ * ComputeAlternates() adds a loop-free alternate first hop per destination,
+ * to fall back on while the network reconverges after a neighbor is lost.
+ */
+class LSSpfEngine
+{
+public:
+  /// (neighbor node, cost) pairs advertised by one originator
+  typedef std::vector<std::pair<uint32_t, uint32_t>> Adjacency;
+
+  /// Cost of a node the source cannot reach
+  static const uint32_t INFINITE_COST = 0xffffffff;
+  /// "No node", e.g. the parent of the source
+  static const uint32_t NO_NODE = 0xffffffff;
+
+  LSSpfEngine ();
+  ~LSSpfEngine ();
+
+  void Clear ();
+
+  /**
+   * \param maxPaths Equal-cost first hops kept per destination; 0 keeps all.
+   */
+  void SetMaxPaths (uint32_t maxPaths);
+
+  /**
+   * \param threads Threads used by full runs; 1 runs serial Dijkstra.
+   *
+   * Incremental repairs stay serial; only rebuilds use the threads.
+   * The parallel run needs every edge cost to be positive; the engine
+   * falls back to the serial one otherwise.
+   */
+  void SetThreads (uint32_t threads);
+
+  /**
+   * \brief Replace the adjacency advertised by originator.
+   *
+   * An empty adjacency withdraws the originator's links.  Repeated
+   * neighbors are collapsed to the cheapest cost.
+   *
+   * \returns true if any edge was added, removed or changed cost.
+   */
+  bool UpdateAdjacency (uint32_t originator, const Adjacency &adjacency);
+
+  /**
+   * \brief Bring the tree rooted at source up to date.
+   *
+   * The tree is repaired incrementally, unless there is none yet, the
+   * source changed, or there are several threads and at least one edge
+   * per 16 nodes changed; it is rebuilt then.  Any number of
+   * UpdateAdjacency() calls, for the same originator or not, may precede it.
+   *
+   * \param source Root node; NO_NODE (or an unknown node) leaves the tree empty.
+   * \param changed Nodes whose cost or first hops changed are appended here.
+   * \returns true if the tree was rebuilt; changed then lists every node.
+   */
+  bool Compute (uint32_t source, std::vector<uint32_t> &changed);
+
+  /**
+   * \brief Rebuild the tree rooted at source from scratch.
+   */
+  void ComputeFull (uint32_t source, std::vector<uint32_t> &changed);
+
+  /**
+   * \returns Cost of the shortest path to node, or INFINITE_COST.
+   */
+  uint32_t GetCost (uint32_t node) const;
+
+  /**
+   * \returns Equal-cost first hops towards node, sorted by node number.
+   */
+  const std::vector<uint32_t> &GetNextHops (uint32_t node) const;
+
+  /**
+   * \brief Pick a loop-free alternate first hop for every node in the tree.
+   *
+   * Neighbor N of the source is loop-free towards D if
+   * cost (N, D) < cost (N, source) + cost (source, D) (RFC 5286), i.e. N
+   * does not route D back through the source.  Of the loop-free neighbors
+   * that are not already first hops towards D, the one with the cheapest
+   * path through it is picked, ties going to the lowest node number.
+   *
+   * The shortest-path tree of every neighbor is kept between calls and
+   * repaired with the edge changes since the last one, as Compute() repairs
+   * the main tree; only a neighbor new to the list takes a full Dijkstra run.
+   *
+   * Only destinations whose cost from the source or from some neighbor may
+   * have moved are looked at again, unless the neighbors, their links or
+   * their costs back to the source changed.
+   *
+   * Call after Compute(); the alternates stay as they are until the next call.
+   *
+   * \param neighbors Candidate first hops; nodes the source has no link to are skipped.
+   * \param changed Destinations whose alternate was looked at again are appended here.
+   */
+  void ComputeAlternates (const std::vector<uint32_t> &neighbors, std::vector<uint32_t> &changed);
+
+  /**
+   * \param node Destination.
+   * \param cost Set to the cost of the path through the alternate.
+   * \returns Loop-free alternate first hop towards node, or NO_NODE.
+   */
+  uint32_t GetAlternate (uint32_t node, uint32_t &cost) const;
+
+  uint32_t GetNNodes () const;
+  uint64_t GetNEdges () const;
+  /**
+   * \returns Approximate heap bytes held by the engine (container capacity,
+   * not counting allocator overhead).
+   */
+  uint64_t GetMemoryUsage () const;
+
+private:
+  struct EdgeChange
+  {
+    uint32_t from;
+    uint32_t to;
+    uint32_t oldCost;
+    uint32_t newCost;
+  };
+  struct AltTree
+  {
+    uint32_t root;                //!< Neighbor of the source, dense
+    uint32_t node;                //!< The same, as node number
+    uint32_t linkCost;            //!< Of the link from the source
+    uint32_t backToSource;        //!< Cost from root to the source
+    std::vector<uint32_t> cost;   //!< From root
+    std::vector<uint32_t> parent;
+  };
+  typedef std::pair<uint32_t, uint32_t> HeapEntry; //!< cost, dense node
+  typedef std::pair<uint32_t, uint32_t> Edge;      //!< dense node, cost
+  typedef std::vector<Edge> EdgeList;
+
+  /**
+   * \brief Edge lists of all nodes packed into one array (compressed sparse row).
+   *
+   * Row i is a slice of m_edges.  A row that shrinks or keeps its size is
+   * rewritten in place; one that grows is copied to the end of the array,
+   * leaving the old slice as garbage.  Pack() rewrites the array in row
+   * order, which SetRow() does by itself once the garbage outweighs the
+   * live edges, so that full runs stream through memory sequentially.
+   *
+   * A Row stays valid until the next SetRow() or Pack() on the table.
+   */
+  class EdgeTable
+  {
+  public:
+    class Row
+    {
+    public:
+      Row (const Edge *begin, uint32_t size)
+        : m_begin (begin),
+          m_size (size)
+      {
+      }
+      uint32_t size () const
+      {
+        return m_size;
+      }
+      const Edge &operator[] (uint32_t i) const
+      {
+        return m_begin[i];
+      }
+      const Edge *begin () const
+      {
+        return m_begin;
+      }
+      const Edge *end () const
+      {
+        return m_begin + m_size;
+      }
+
+    private:
+      const Edge *m_begin;
+      uint32_t m_size;
+    };
+
+    EdgeTable ();
+    void Clear ();
+    /**
+     * \brief Add an empty row at the end.
+     */
+    void AddRow ();
+    Row operator[] (uint32_t row) const
+    {
+      return Row (m_edges.data () + m_rows[row].start, m_rows[row].size);
+    }
+    void SetRow (uint32_t row, const Edge *begin, const Edge *end);
+    /**
+     * \brief Drop the garbage and put the rows back in order; no-op if they are.
+     */
+    void Pack ();
+    /**
+     * \returns Bytes held by the table, garbage included.
+     */
+    uint64_t GetMemoryUsage () const;
+
+  private:
+    struct Slice
+    {
+      uint32_t start;
+      uint32_t size;
+    };
+    std::vector<Edge> m_edges;
+    std::vector<Slice> m_rows;
+    uint64_t m_garbage; //!< Edges in m_edges that belong to no row
+    uint32_t m_lastRow; //!< Row whose slice ends m_edges, or NO_NODE
+    bool m_packed;      //!< No garbage, and the rows are stored in order
+  };
+
+  LSSpfEngine (const LSSpfEngine &);
+  LSSpfEngine &operator= (const LSSpfEngine &);
+
+  uint32_t GetIndex (uint32_t node);
+  /**
+   * \brief Collapse changes to one net change per edge, dropping those
+   * that came back to their old cost.
+   */
+  static void MergeChanges (std::vector<EdgeChange> &changes);
+  /**
+   * \brief Bring a tree built before changes up to date with them.
+   *
+   * \param touched Nodes whose cost may have moved, and the heads of the
+   *        changed edges, are appended here.
+   */
+  void RepairTree (const std::vector<EdgeChange> &changes, std::vector<uint32_t> &cost,
+                   std::vector<uint32_t> &parent, std::vector<uint32_t> &touched) const;
+  /**
+   * \brief Pick the alternate of one destination from m_altTrees.
+   */
+  void SelectAlternate (uint32_t index);
+  /**
+   * \brief Delta-stepping over m_workers; same result as the serial ComputeFull().
+   */
+  void ComputeFullParallel (std::vector<uint32_t> &changed);
+  /**
+   * \brief Derive the equal-cost first hops of a node from its predecessors.
+   *
+   * \returns true if the set changed.
+   */
+  bool ComputeNextHops (uint32_t index);
+  /**
+   * \brief Plain Dijkstra from a dense index; the main tree is not touched.
+   */
+  void ComputeTreeFrom (uint32_t root, std::vector<uint32_t> &cost, std::vector<uint32_t> &parent) const;
+
+  std::unordered_map<uint32_t, uint32_t> m_index; //!< Node number -> dense index
+  std::vector<uint32_t> m_nodes;                  //!< Dense index -> node number
+  EdgeTable m_outEdges;                           //!< Rows sorted by head
+  EdgeTable m_inEdges;
+  std::vector<uint32_t> m_cost;
+  std::vector<uint32_t> m_parent;
+  std::vector<std::vector<uint32_t>> m_nextHops; //!< As node numbers
+  std::vector<EdgeChange> m_changes;             //!< Queued for the next Compute()
+  std::vector<uint32_t> m_altNextHop;            //!< Loop-free alternate, as node number
+  std::vector<uint32_t> m_altCost;               //!< Cost of the path through it
+  uint64_t m_nEdges;
+  uint64_t m_costSum;      //!< Sum of all edge costs, to size the delta-stepping buckets
+  uint64_t m_nZeroCost;    //!< Edges of cost 0, which rule out the parallel run
+  LSSpfWorkers *m_workers; //!< 0 when running single-threaded
+  uint32_t m_maxPaths;
+  uint32_t m_source;
+  bool m_valid;
+  std::vector<uint32_t> m_altNeighbors; //!< Candidates of the last ComputeAlternates()
+  std::vector<AltTree> m_altTrees;      //!< One per candidate linked to the source
+  std::vector<EdgeChange> m_altChanges; //!< Not yet applied to m_altTrees
+  std::vector<uint32_t> m_altDirty;     //!< Destinations to look at again, dense
+  uint32_t m_altSource;                 //!< Source of the last ComputeAlternates()
+  bool m_altAll;                        //!< Every destination has to be looked at again
+  uint64_t m_altVersion;                //!< m_version at the last ComputeAlternates()
+  uint64_t m_version;                   //!< Bumped on every adjacency or setting change
+};
+
+#endif
@@ -0,0 +1,201 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/ls-timer-wheel.h"
+
+LSTimerWheel::LSTimerWheel () : m_current (0) {}
+
+void
+LSTimerWheel::Clear ()
+{
+  for (uint32_t level = 0; level < LEVELS; level++)
+    {
+      for (uint32_t i = 0; i < SLOTS; i++)
+        {
+          m_slots[level][i].clear ();
+        }
+    }
+  m_deadline.clear ();
+}
+
+void
+LSTimerWheel::Schedule (uint64_t key, uint64_t tick)
+{
+  if (tick <= m_current)
+    {
+      tick = m_current + 1;
+    }
+  m_deadline[key] = tick;
+  Entry entry = {key, tick};
+  File (entry);
+}
+
+void
+LSTimerWheel::Cancel (uint64_t key)
+{
+  // The slot entry goes stale and is dropped when its slot comes up.
+  m_deadline.erase (key);
+}
+
+bool
+LSTimerWheel::IsScheduled (uint64_t key) const
+{
+  return m_deadline.find (key) != m_deadline.end ();
+}
+
+void
+LSTimerWheel::File (const Entry &entry)
+{
+  // Lowest level whose span still covers the deadline; anything beyond the
+  // top level waits there and is refiled when its slot comes round.
+  uint64_t delta = entry.tick - m_current;
+  uint32_t level = 0;
+  while (level + 1 < LEVELS && delta >= ((uint64_t)1 << (SLOT_BITS * (level + 1))))
+    {
+      level++;
+    }
+  m_slots[level][(entry.tick >> (SLOT_BITS * level)) & (SLOTS - 1)].push_back (entry);
+}
+
+bool
+LSTimerWheel::IsLive (const Entry &entry) const
+{
+  std::unordered_map<uint64_t, uint64_t>::const_iterator live = m_deadline.find (entry.key);
+  return live != m_deadline.end () && live->second == entry.tick;
+}
+
+bool
+LSTimerWheel::HasLive (const std::vector<Entry> &slot) const
+{
+  for (uint32_t i = 0; i < slot.size (); i++)
+    {
+      if (IsLive (slot[i]))
+        {
+          return true;
+        }
+    }
+  return false;
+}
+
+bool
+LSTimerWheel::GetNextExpiry (uint64_t &tick) const
+{
+  if (m_deadline.empty ())
+    {
+      return false;
+    }
+  // Level 0 holds deadlines of the next 64 ticks, one tick per slot.
+  uint64_t next = ~(uint64_t)0;
+  for (uint64_t t = m_current + 1; t <= m_current + SLOTS; t++)
+    {
+      if (HasLive (m_slots[0][t & (SLOTS - 1)]))
+        {
+          next = t;
+          break;
+        }
+    }
+  // A higher level slot is worked on when the wheel reaches its start.
+  // Those starts only get further apart going up, so stop at the first
+  // level that cannot beat what was found.
+  for (uint32_t level = 1; level < LEVELS; level++)
+    {
+      uint32_t shift = SLOT_BITS * level;
+      uint64_t start = ((m_current >> shift) + 1) << shift;
+      if (start >= next)
+        {
+          break;
+        }
+      for (uint32_t i = 0; i < SLOTS && start < next; i++, start += (uint64_t)1 << shift)
+        {
+          if (HasLive (m_slots[level][(start >> shift) & (SLOTS - 1)]))
+            {
+              next = start;
+            }
+        }
+    }
+  // Every slot of every level was looked at, so an armed key was found.
+  tick = next;
+  return true;
+}
+
+void
+LSTimerWheel::Advance (uint64_t tick, std::vector<uint64_t> &expired)
+{
+  while (m_current < tick)
+    {
+      if (m_deadline.empty ())
+        {
+          // Only stale entries are left; drop them and jump ahead.
+          Clear ();
+          m_current = tick;
+          return;
+        }
+      m_current++;
+
+      // Crossing a slot boundary of a higher level brings that slot's
+      // entries one level closer.  Deadlines past the top level's span may
+      // land in the same slot again, hence the swap.
+      for (uint32_t level = 1; level < LEVELS; level++)
+        {
+          if (m_current & (((uint64_t)1 << (SLOT_BITS * level)) - 1))
+            {
+              break;
+            }
+          m_cascade.swap (m_slots[level][(m_current >> (SLOT_BITS * level)) & (SLOTS - 1)]);
+          for (uint32_t i = 0; i < m_cascade.size (); i++)
+            {
+              if (IsLive (m_cascade[i]))
+                {
+                  File (m_cascade[i]);
+                }
+            }
+          m_cascade.clear ();
+        }
+
+      // Everything live in this slot is due now: an entry for a later
+      // turn would have been filed on a higher level.
+      std::vector<Entry> &due = m_slots[0][m_current & (SLOTS - 1)];
+      for (uint32_t i = 0; i < due.size (); i++)
+        {
+          if (!IsLive (due[i]))
+            {
+              continue; // cancelled or re-armed since
+            }
+          if (due[i].tick <= m_current)
+            {
+              expired.push_back (due[i].key);
+              m_deadline.erase (due[i].key);
+            }
+          else
+            {
+              File (due[i]);
+            }
+        }
+      due.clear ();
+    }
+}
+
+uint64_t
+LSTimerWheel::GetCurrentTick () const
+{
+  return m_current;
+}
+
+uint32_t
+LSTimerWheel::GetNScheduled () const
+{
+  return m_deadline.size ();
+}
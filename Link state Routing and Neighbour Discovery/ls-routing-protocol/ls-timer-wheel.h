@@ -0,0 +1,106 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef LS_TIMER_WHEEL_H
+#define LS_TIMER_WHEEL_H
+
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * \brief Hierarchical timing wheel of per-key deadlines, in integer ticks.
+ *
+ * Level k has 64 slots of 64^k ticks each.  A deadline is filed on the
+ * lowest level whose span covers it, and moves down one level each time
+ * the wheel reaches the start of its slot, so every entry is touched once
+ * per level at most.  Advancing by one tick visits one level-0 slot and,
+ * on slot boundaries, one slot of each higher level: the cost is
+ * O(expired) per tick, independent of how many deadlines are armed.
+ *
+ * Re-arming a key is O(1): the new deadline replaces the old one in the
+ * key index, and the stale slot entry is dropped when it is next visited.
+ *
+ * The wheel has no notion of time itself; the owner converts simulation
+ * time to ticks and calls Advance() from its own timer, set for the tick
+ * GetNextExpiry() returns.
+ */
+class LSTimerWheel
+{
+public:
+  LSTimerWheel ();
+
+  void Clear ();
+
+  /**
+   * \brief Arm key to expire at tick, replacing any earlier deadline.
+   *
+   * Deadlines not after the current tick expire on the next Advance().
+   */
+  void Schedule (uint64_t key, uint64_t tick);
+
+  void Cancel (uint64_t key);
+
+  bool IsScheduled (uint64_t key) const;
+
+  /**
+   * \brief Move the wheel to tick and collect the keys that expired.
+   *
+   * When nothing is armed the wheel jumps straight to tick.
+   *
+   * \param tick New current tick; earlier ticks are ignored.
+   * \param expired Expired keys are appended here, in deadline order.
+   */
+  void Advance (uint64_t tick, std::vector<uint64_t> &expired);
+
+  /**
+   * \brief Earliest tick at which Advance() may have work to do.
+   *
+   * That is the first slot holding a live deadline: on level 0 the
+   * deadline itself, on higher levels the start of the slot, when its
+   * entries move down.  Never later than the earliest deadline.
+   *
+   * \param tick Set to that tick.
+   * \returns false if nothing is armed.
+   */
+  bool GetNextExpiry (uint64_t &tick) const;
+
+  uint64_t GetCurrentTick () const;
+
+  uint32_t GetNScheduled () const;
+
+private:
+  static const uint32_t LEVELS = 4;
+  static const uint32_t SLOT_BITS = 6;
+  static const uint32_t SLOTS = 1 << SLOT_BITS;
+
+  struct Entry
+  {
+    uint64_t key;
+    uint64_t tick;
+  };
+
+  void File (const Entry &entry);
+  bool IsLive (const Entry &entry) const;
+  bool HasLive (const std::vector<Entry> &slot) const;
+
+  std::vector<Entry> m_slots[LEVELS][SLOTS];
+  std::unordered_map<uint64_t, uint64_t> m_deadline; //!< Live deadline of every armed key
+  std::vector<Entry> m_cascade;                      //!< Scratch space for Advance()
+  uint64_t m_current;
+};
+
+#endif